@@ -0,0 +1,143 @@
+#include "agingFilter.h"
+
+using namespace std;
+
+//Constructor for the aging filter.
+//A lookup checks every generation, so the false positive rates of the generations add up:
+//each is sized for p/g with m/g keys, the keys it gets in its share of the window.
+AgingBloomFilter::AgingBloomFilter(double p, int m, int generations, double windowSeconds, BloomLayout layout,
+                                   uint64_t seed){
+    numGen = generations < 2 ? 2 : generations;
+    perGeneration = max((m + numGen - 1) / numGen, 1);
+    generationSeconds = windowSeconds > 0 ? windowSeconds / numGen : 0;
+    this->layout = layout;
+    this->seed = seed;
+    size = BloomFilter::BloomFilterSize(p / numGen, perGeneration, 1.0);
+    if(layout == BLOOM_BLOCKED){
+        size = ((size + BLOCK_BITS - 1) / BLOCK_BITS) * BLOCK_BITS;
+    }
+    if(size < BLOCK_BITS){
+        size = BLOCK_BITS;
+    }
+    numHash = BloomFilter::numHashFunctions(size, perGeneration, 1.0);
+    for(int i = 0; i < numGen; i++){
+        gens.push_back(new BitArray(size));
+    }
+    newest = 0;
+    newestCount = 0;
+    rotations = 0;
+    opsSinceTick = 0;
+    lastRotation = chrono::steady_clock::now();
+}
+
+//aging filter destructor.
+AgingBloomFilter::~AgingBloomFilter(){
+    for(BitArray* bits : gens){
+        delete bits;
+    }
+}
+
+//hashes a string into 64 bits using the seed of this filter.
+uint64_t AgingBloomFilter::keyHash(string_view element){
+    return hashKey(element.data(), element.size(), seed);
+}
+
+//The bits of a key are picked the same way as in BloomFilter, and are the same in every generation.
+bool AgingBloomFilter::testIn(BitArray* bits, uint64_t elem){
+    if(layout == BLOOM_BLOCKED){
+        uint64_t base = reduceRange(elem, size / BLOCK_BITS) * BLOCK_BITS;
+        bool all = true;
+        for(unsigned int i = 0; i < numHash; i++){
+            all &= bits->test(blockedProbe(elem, i, base));
+        }
+        return all;
+    }
+    for(unsigned int i = 0; i < numHash; i++){
+        if(!bits->test(classicProbe(elem, i, size))){
+            return false;
+        }
+    }
+    return true;
+}
+
+void AgingBloomFilter::setIn(BitArray* bits, uint64_t elem){
+    uint64_t base = layout == BLOOM_BLOCKED ? reduceRange(elem, size / BLOCK_BITS) * BLOCK_BITS : 0;
+    for(unsigned int i = 0; i < numHash; i++){
+        bits->set(layout == BLOOM_BLOCKED ? blockedProbe(elem, i, base) : classicProbe(elem, i, size));
+    }
+}
+
+//inserts a string into the newest generation, rotating first if the newest is full
+void AgingBloomFilter::insert(string_view element){
+    countOp();
+    if(generationSeconds == 0 && newestCount >= perGeneration){
+        rotate();
+    }
+    setIn(gens[newest], keyHash(element));
+    newestCount++;
+}
+
+//checks the generations from newest to oldest, since a key seen recently is most likely
+//to be seen again
+bool AgingBloomFilter::find(string_view element){
+    countOp();
+    uint64_t elem = keyHash(element);
+    for(int i = 0; i < numGen; i++){
+        if(testIn(gens[(newest - i + numGen) % numGen], elem)){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AgingBloomFilter::insertIfNew(string_view element){
+    bool seen = find(element);
+    insert(element);
+    return !seen;
+}
+
+//The oldest generation is the one after the newest in the ring. Clearing it is one pass
+//of memset over its words.
+void AgingBloomFilter::rotate(){
+    newest = (newest + 1) % numGen;
+    gens[newest]->clear();
+    newestCount = 0;
+    rotations++;
+    lastRotation = chrono::steady_clock::now();
+}
+
+//After a quiet spell longer than the whole window every generation is out of date, so at
+//most numGen rotations are done however long it has been.
+void AgingBloomFilter::tick(){
+    opsSinceTick = 0;
+    if(generationSeconds == 0){
+        return;
+    }
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - lastRotation).count();
+    if(elapsed < generationSeconds){
+        return;
+    }
+    int due = (int) min(elapsed / generationSeconds, (double) numGen);
+    for(int i = 0; i < due; i++){
+        rotate();
+    }
+    //keeps the generations on the original schedule instead of starting from now
+    lastRotation = now - chrono::duration_cast<chrono::steady_clock::duration>(
+                             chrono::duration<double>(elapsed - due * generationSeconds));
+    if(due == numGen){
+        lastRotation = now;
+    }
+}
+
+//reading the clock costs about as much as a lookup, so it is only done every 256 operations
+void AgingBloomFilter::countOp(){
+    if(++opsSinceTick >= 256){
+        tick();
+    }
+}
+
+//bytes of all of the bit arrays
+unsigned long long AgingBloomFilter::bytes(){
+    return (unsigned long long) numGen * gens[0]->nwords * 8;
+}
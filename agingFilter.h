@@ -0,0 +1,64 @@
+#ifndef AGING_H
+#define AGING_H
+
+#include <vector>
+#include <chrono>
+#include "bloomFilter.h"
+
+//Bloom filter over a sliding window of a stream, for deduplicating an endless stream.
+//The window is split into g generations, each its own bit array. Keys are inserted into the
+//newest generation and looked up in all of them. When the newest has had its share of the
+//window (m/g inserts, or windowSeconds/g seconds) the oldest generation is cleared and becomes
+//the newest, so old keys are forgotten a generation at a time without any per key deletes,
+//and the memory stays at g bit arrays however long the stream runs.
+//A key is remembered for between (g-1)/g of a window and a whole window after it was last
+//inserted. More generations make that closer to exactly one window, at the cost of a few
+//more bits per key for the same false positive rate and one more array to check per lookup.
+//Not safe to use from many threads at once.
+class AgingBloomFilter {
+  public:
+    //constructor.
+    //p = false positive rate of a lookup across the whole window
+    //m = number of keys in one window (for a time window, the most expected in one)
+    //generations = number of generations the window is split into, at least 2
+    //windowSeconds = length of the window in seconds, or 0 for a window of the last m inserts
+    //layout = bit layout of the generations. Blocked lookups are faster, but each generation
+    //is sized for a low rate, where the blocked layout comes out at about 1.5 times p
+    //seed = seed of the key hash
+    AgingBloomFilter(double p, int m, int generations = 4, double windowSeconds = 0,
+                     BloomLayout layout = BLOOM_CLASSIC, uint64_t seed = DEFAULT_SEED);
+    ~AgingBloomFilter(); //destructor
+    void insert(string_view element); //inserts into the newest generation
+    bool find(string_view element); //checks every live generation
+    //Dedup in one call: returns true if element wasn't seen in the window, and inserts it
+    //either way, so a key seen again is remembered from its latest sighting.
+    bool insertIfNew(string_view element);
+    void rotate(); //forgets the oldest generation and starts a new one
+    //Rotates as many times as the clock says it is due for a time window. insert and find call
+    //this every 256 operations; call it from a timer if the stream can go quiet for long.
+    void tick();
+    uint64_t keyHash(string_view element); //hashes a string with the filter's seed
+    unsigned long long bytes(); //memory used by the bit arrays
+
+    //Data
+    int numGen; //number of generations
+    unsigned long long size; //bits in each generation
+    unsigned int numHash; //number of hash functions
+    BloomLayout layout; //bit layout of the generations
+    uint64_t seed; //seed which picks the key hash function out of the family
+    unsigned long long perGeneration; //inserts before a rotation, for a count window
+    double generationSeconds; //seconds before a rotation, 0 for a count window
+    vector<BitArray*> gens; //bit arrays, a ring with the newest at newest
+    int newest; //index in gens of the newest generation
+    unsigned long long newestCount; //inserts into the newest generation
+    unsigned long long rotations; //number of rotations so far
+    unsigned int opsSinceTick; //operations since the clock was last checked
+    chrono::steady_clock::time_point lastRotation; //when the newest generation started
+
+  private:
+    bool testIn(BitArray* bits, uint64_t elem); //true if all of elem's bits are set in bits
+    void setIn(BitArray* bits, uint64_t elem); //sets elem's bits in bits
+    void countOp(); //checks the clock every 256 operations
+};
+
+#endif
@@ -0,0 +1,722 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "bloomFilter.h"
+#include "fuseFilter.h"
+#include "cuckooFilter.h"
+#include "countingFilter.h"
+#include "scalableFilter.h"
+#include "agingFilter.h"
+#include "shardedFilter.h"
+#include "compressedFilter.h"
+#include "filterServer.h"
+#include "checkpoint.h"
+
+//Benchmark harness for the bloom filter.
+//Build with: g++ -std=c++17 -O2 -pthread bloomFilter.cpp fuseFilter.cpp cuckooFilter.cpp countingFilter.cpp scalableFilter.cpp agingFilter.cpp shardedFilter.cpp compressedFilter.cpp filterServer.cpp checkpoint.cpp benchmark.cpp -o benchmark
+//Run with: ./benchmark [--max-bytes N] [--ops N] [--threads N]
+//--max-bytes = largest filter to test, in bytes (default 1 GB). Sizes go 16 KB, 256 KB, 4 MB, 64 MB, 1 GB.
+//--ops = number of keys each timed operation runs on (default 1000000)
+//--threads = most threads for the concurrent scaling test (default: number of cores)
+//Each size also builds binary fuse filters, a cuckoo filter and a counting bloom filter from
+//the same number of keys, up to 16 million keys, and measures the compressed export format on the same keys.
+//The scalable filter test then grows a filter from a guess of 1000 keys to 2 * --ops keys, and
+//the aging filter test streams 10 windows of keys through a filter with a window of --ops / 10.
+//The sharded filter test runs last and compares lookups of keys on a thread's own NUMA node
+//with lookups of keys on another node, and the filter server test after it times lookups
+//through a Unix domain socket for a few batch sizes, one batch at a time and pipelined.
+//The checkpoint test compares incremental checkpoints after a few amounts of churn with
+//writing a full snapshot, for the largest filter size up to 64 MB.
+//Filter creation time is measured first for sizes up to --max-bytes.
+//Keys are made up from their index so no input files are needed, and every filter is
+//filled to the number of elements it was sized for before lookups are timed.
+
+using namespace std;
+
+//Counts last level cache misses of this thread with the kernel's perf events.
+//If perf events aren't allowed (containers, perf_event_paranoid) ok is false and the
+//benchmark prints n/a instead.
+class PerfCounter {
+  public:
+    PerfCounter();
+    ~PerfCounter();
+    void start(); //resets and starts counting
+    uint64_t stop(); //stops counting and returns the number of misses
+    bool ok; //true if the counter could be opened
+    int fd; //perf event file descriptor
+};
+
+PerfCounter::PerfCounter(){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    ok = fd >= 0;
+}
+
+PerfCounter::~PerfCounter(){
+    if(ok){
+        close(fd);
+    }
+}
+
+void PerfCounter::start(){
+    if(ok){
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+uint64_t PerfCounter::stop(){
+    uint64_t count = 0;
+    if(ok){
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(fd, &count, sizeof(count)) != sizeof(count)){
+            count = 0;
+        }
+    }
+    return count;
+}
+
+//Synthetic keys.
+//Key i is the 16 hex digits of a scrambled i, so keys look random but the same key
+//can be made again from its index. Inserted keys use small indices, missing keys have
+//the top bit set so they can never be one of the inserted keys.
+const uint64_t MISSING = uint64_t(1) << 63;
+const int KEY_LEN = 16;
+
+static inline uint64_t mix64(uint64_t x){
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static inline void makeKey(uint64_t i, char* out){
+    const char* digits = "0123456789abcdef";
+    uint64_t x = mix64(i);
+    for(int j = 0; j < KEY_LEN; j++){
+        out[j] = digits[(x >> (4 * j)) & 15];
+    }
+}
+
+//makes count keys. index(j) gives the index of the j'th key.
+template <class Index>
+vector<string> makeKeys(size_t count, Index index){
+    vector<string> keys(count, string(KEY_LEN, ' '));
+    for(size_t j = 0; j < count; j++){
+        makeKey(index(j), &keys[j][0]);
+    }
+    return keys;
+}
+
+//Times f, which does ops operations, and prints one row of the results table.
+template <class F>
+void measure(const char* name, size_t ops, PerfCounter& perf, F f){
+    perf.start();
+    auto start = chrono::steady_clock::now();
+    f();
+    auto end = chrono::steady_clock::now();
+    uint64_t misses = perf.stop();
+    double ns = chrono::duration<double, nano>(end - start).count() / ops;
+    char missText[32];
+    if(perf.ok){
+        snprintf(missText, sizeof(missText), "%.2f", double(misses) / ops);
+    }else{
+        snprintf(missText, sizeof(missText), "n/a");
+    }
+    printf("    %-20s %10.1f ns/op %10.2f Mops/s %12s misses/op\n", name, ns, 1e3 / ns, missText);
+}
+
+//Benchmarks one filter of the given size in bytes.
+//The filter is sized for p = 0.01, and then filled with as many keys as it was sized for:
+//the first ops with insert and the next ops with insertMany are timed, the rest are added untimed.
+void benchFilter(unsigned long long bytes, BloomLayout layout, size_t ops, PerfCounter& perf){
+    //BloomFilterSize gives about 9.6 bits per element for p = 0.01
+    double p = 0.01;
+    int n = (int) min(bytes * 8 / 9.585, 2e9);
+    BloomFilter b(p, n, 1.0, 1.0, layout);
+    size_t timed = min(ops, (size_t) n / 2);
+    printf("  %s layout: %llu bits, k = %u, n = %d\n", layout == BLOOM_CLASSIC ? "classic" : "blocked",
+           b.size, b.numHash, n);
+
+    vector<string> first = makeKeys(timed, [](size_t j){ return j; });
+    vector<string> second = makeKeys(timed, [timed](size_t j){ return timed + j; });
+    vector<string_view> secondViews(second.begin(), second.end());
+    measure("insert", timed, perf, [&](){
+        for(size_t j = 0; j < timed; j++){
+            b.insert(first[j]);
+        }
+    });
+    measure("insertMany", timed, perf, [&](){
+        b.insertMany(secondViews.data(), timed);
+    });
+    //filling the rest of the filter untimed, keys are made in chunks as they are needed
+    const size_t CHUNK = 65536;
+    vector<string> chunk(CHUNK, string(KEY_LEN, ' '));
+    vector<string_view> chunkViews(chunk.begin(), chunk.end());
+    for(uint64_t start = 2 * timed; start < (uint64_t) n; start += CHUNK){
+        size_t count = min((uint64_t) CHUNK, n - start);
+        for(size_t j = 0; j < count; j++){
+            makeKey(start + j, &chunk[j][0]);
+        }
+        b.insertMany(chunkViews.data(), count);
+    }
+
+    //lookups of inserted keys spread over the whole filter, and of keys never inserted
+    vector<string> present = makeKeys(ops, [n](size_t j){ return mix64(j ^ 0x5555) % n; });
+    vector<string> missing = makeKeys(ops, [](size_t j){ return MISSING | j; });
+    vector<string_view> presentViews(present.begin(), present.end());
+    vector<string_view> missingViews(missing.begin(), missing.end());
+    vector<uint64_t> found((ops + 63) / 64);
+    size_t falseNeg = 0;
+    size_t falsePos = 0;
+    measure("find (present)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falseNeg += !b.find(present[j]);
+        }
+    });
+    measure("find (missing)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falsePos += b.find(missing[j]);
+        }
+    });
+    measure("findMany (present)", ops, perf, [&](){
+        b.findMany(presentViews.data(), ops, found.data());
+    });
+    measure("findMany (missing)", ops, perf, [&](){
+        b.findMany(missingViews.data(), ops, found.data());
+    });
+    //removes go last since they change what find returns
+    measure("remove", timed, perf, [&](){
+        for(size_t j = 0; j < timed; j++){
+            b.remove(present[j]);
+        }
+    });
+    printf("    false negatives %zu, false positive rate observed %.5f, theoretical %.5f\n", falseNeg,
+           double(falsePos) / ops, BloomFilter::expectedFpr(layout, b.size, b.numHash, n));
+}
+
+//Benchmarks binary fuse filters of n keys with 8 and 16 bit fingerprints, for comparing
+//with the bloom filters of the same n.
+void benchFuse(int n, size_t ops, PerfCounter& perf){
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    vector<string> present = makeKeys(ops, [n](size_t j){ return mix64(j ^ 0x5555) % n; });
+    vector<string> missing = makeKeys(ops, [](size_t j){ return MISSING | j; });
+    for(int bits : {8, 16}){
+        auto start = chrono::steady_clock::now();
+        BinaryFuseFilter f(keys, bits);
+        double buildSec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("  fuse%d: %.2f bits per key, built in %.3f s (%.1f ns/key)\n", bits, f.bitsPerKey(), buildSec,
+               buildSec * 1e9 / max(n, 1));
+        size_t falseNeg = 0;
+        size_t falsePos = 0;
+        measure("find (present)", ops, perf, [&](){
+            for(size_t j = 0; j < ops; j++){
+                falseNeg += !f.find(present[j]);
+            }
+        });
+        measure("find (missing)", ops, perf, [&](){
+            for(size_t j = 0; j < ops; j++){
+                falsePos += f.find(missing[j]);
+            }
+        });
+        printf("    false negatives %zu, false positive rate observed %.5f, theoretical %.5f\n", falseNeg,
+               double(falsePos) / ops, pow(2.0, -bits));
+    }
+}
+
+//Benchmarks a cuckoo filter of n keys with fingerprints for a false positive rate of 0.01.
+//Removes are timed on the keys which were inserted first, after the lookups.
+void benchCuckoo(int n, size_t ops, PerfCounter& perf){
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    vector<string> present = makeKeys(ops, [n](size_t j){ return mix64(j ^ 0x5555) % n; });
+    vector<string> missing = makeKeys(ops, [](size_t j){ return MISSING | j; });
+    CuckooFilter f(n, CuckooFilter::fingerprintBits(0.01));
+    size_t timed = min(ops, (size_t) n);
+    size_t failed = 0;
+    measure("insert", n, perf, [&](){
+        for(int j = 0; j < n; j++){
+            failed += !f.insert(keys[j]);
+        }
+    });
+    size_t falseNeg = 0;
+    size_t falsePos = 0;
+    measure("find (present)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falseNeg += !f.find(present[j]);
+        }
+    });
+    measure("find (missing)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falsePos += f.find(missing[j]);
+        }
+    });
+    measure("remove", timed, perf, [&](){
+        for(size_t j = 0; j < timed; j++){
+            f.remove(keys[j]);
+        }
+    });
+    printf("  cuckoo%d: %.2f bits per key, load %.3f, %zu inserts failed\n", f.bits,
+           8.0 * f.bytes() / n, double(n) / (f.numBuckets * 4), failed);
+    printf("    false negatives %zu, false positive rate observed %.5f, theoretical %.5f\n", falseNeg,
+           double(falsePos) / ops, 8.0 / (1 << f.bits));
+}
+
+//Benchmarks a counting bloom filter of n keys with 4 bit counters for p = 0.01, the deletable
+//filter the cuckoo filter is compared with. After the lookups the first half of the keys (up to
+//ops of them) are removed, and then looked up again: a removed key should only still be found
+//as often as a key which was never inserted, and none of the keys left may go missing.
+void benchCounting(int n, size_t ops, PerfCounter& perf){
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    vector<string> present = makeKeys(ops, [n](size_t j){ return mix64(j ^ 0x5555) % n; });
+    vector<string> missing = makeKeys(ops, [](size_t j){ return MISSING | j; });
+    CountingBloomFilter f(0.01, n, 1.0, 1.0);
+    size_t timed = min(ops, (size_t) n / 2);
+    measure("insert", n, perf, [&](){
+        for(int j = 0; j < n; j++){
+            f.insert(keys[j]);
+        }
+    });
+    size_t falseNeg = 0;
+    size_t falsePos = 0;
+    measure("find (present)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falseNeg += !f.find(present[j]);
+        }
+    });
+    measure("find (missing)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falsePos += f.find(missing[j]);
+        }
+    });
+    measure("remove", timed, perf, [&](){
+        for(size_t j = 0; j < timed; j++){
+            f.remove(keys[j]);
+        }
+    });
+    size_t stillFound = 0;
+    for(size_t j = 0; j < timed; j++){
+        stillFound += f.find(keys[j]);
+    }
+    size_t lost = 0;
+    for(size_t j = timed; j < (size_t) n; j++){
+        lost += !f.find(keys[j]);
+    }
+    size_t falsePosAfter = 0;
+    for(size_t j = 0; j < ops; j++){
+        falsePosAfter += f.find(missing[j]);
+    }
+    printf("  counting%d: %.2f bits per key, k = %u\n", f.counters->bits, 64.0 * f.counters->nwords / n, f.numHash);
+    printf("    false negatives %zu, false positive rate observed %.5f, theoretical %.5f\n", falseNeg,
+           double(falsePos) / ops, BloomFilter::expectedFpr(BLOOM_CLASSIC, f.size, f.numHash, n));
+    printf("    after removing %zu: %zu still found (rate %.5f, never inserted %.5f), %zu of the rest lost\n",
+           timed, stillFound, double(stillFound) / max(timed, (size_t) 1), double(falsePosAfter) / ops, lost);
+}
+
+//Benchmarks a scalable bloom filter with p = 0.01 whose first filter is sized for 1000 keys,
+//inserting n keys so it has to grow many times. Checks that the false positive rate observed
+//once it has grown stays under p, and that no key went missing.
+void benchScalable(int n, size_t ops, PerfCounter& perf){
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    vector<string> present = makeKeys(ops, [n](size_t j){ return mix64(j ^ 0x5555) % n; });
+    vector<string> missing = makeKeys(ops, [](size_t j){ return MISSING | j; });
+    double p = 0.01;
+    ScalableBloomFilter f(p, 1000);
+    printf("Scalable filter, p = %.2f, first filter for 1000 keys, n = %d\n", p, n);
+    measure("insert", n, perf, [&](){
+        for(int j = 0; j < n; j++){
+            f.insert(keys[j]);
+        }
+    });
+    size_t falseNeg = 0;
+    size_t falsePos = 0;
+    measure("find (present)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falseNeg += !f.find(present[j]);
+        }
+    });
+    measure("find (missing)", ops, perf, [&](){
+        for(size_t j = 0; j < ops; j++){
+            falsePos += f.find(missing[j]);
+        }
+    });
+    double observed = double(falsePos) / ops;
+    printf("    %zu filters, newest for %.0f keys, %.2f bits per key, newest %.2f full (limit %.2f)\n",
+           f.filters.size(), f.m * pow(f.s, f.filters.size() - 1), double(f.totalBits()) / n, f.fillRatio(),
+           f.fillLimits.back());
+    printf("    false negatives %zu, false positive rate observed %.5f, bound %.5f (p %.2f)%s\n", falseNeg,
+           observed, f.falsePositiveBound(), p, observed <= p && falseNeg == 0 ? "" : " (OVER THE BOUND)");
+}
+
+//Benchmarks an aging filter with p = 0.01, a window of the last m inserts and 4 generations,
+//streaming 10 windows of distinct keys through insertIfNew so it rotates about 40 times.
+//Every key is new, so each insertIfNew which says it isn't is a false positive over the window.
+//At the end the keys of the last 3/4 window have to be found, keys from two windows back
+//should be found only as often as keys never inserted, and the rate of those is the window's
+//false positive rate.
+void benchAging(int m, PerfCounter& perf){
+    const int GENERATIONS = 4;
+    int n = 10 * m;
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    vector<string> missing = makeKeys(m, [](size_t j){ return MISSING | j; });
+    for(BloomLayout layout : {BLOOM_CLASSIC, BLOOM_BLOCKED}){
+        AgingBloomFilter f(0.01, m, GENERATIONS, 0, layout);
+        printf("Aging filter, %s layout, p = 0.01, window %d, %d generations of %llu bits, k = %u\n",
+               layout == BLOOM_CLASSIC ? "classic" : "blocked", m, f.numGen, f.size, f.numHash);
+        size_t seen = 0;
+        measure("insertIfNew", n, perf, [&](){
+            for(int j = 0; j < n; j++){
+                seen += !f.insertIfNew(keys[j]);
+            }
+        });
+        size_t falsePos = 0;
+        measure("find (missing)", m, perf, [&](){
+            for(int j = 0; j < m; j++){
+                falsePos += f.find(missing[j]);
+            }
+        });
+        int recent = m / GENERATIONS * (GENERATIONS - 1);
+        size_t falseNeg = 0;
+        for(int j = n - recent; j < n; j++){
+            falseNeg += !f.find(keys[j]);
+        }
+        size_t forgotten = 0;
+        for(int j = n - 3 * m; j < n - 2 * m; j++){
+            forgotten += f.find(keys[j]);
+        }
+        printf("    %llu rotations, %.2f bits per key of the window, false negatives in the last %d: %zu\n",
+               f.rotations, 8.0 * f.bytes() / m, recent, falseNeg);
+        printf("    false positive rate observed %.5f (while streaming %.5f), keys two windows old found %.5f\n",
+               double(falsePos) / m, double(seen) / n, double(forgotten) / m);
+    }
+}
+
+//Measures the compressed export format (see compressedFilter.h) on filters of n keys: bytes
+//sent per key, and how fast the bit array is coded and decoded, for a normal filter (which is
+//sent as it is) and for bigger filters with 2 and 1 hash functions, which compress.
+//Speeds are in GB of bit array per second, the same measure as copying it uncompressed.
+void benchCompress(int n, size_t ops){
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    vector<string_view> views(keys.begin(), keys.end());
+    vector<string> missing = makeKeys(ops, [](size_t j){ return MISSING | j; });
+    float shapes[3][2] = {{1.0f, 1.0f}, {3.0f, 0.3f}, {6.0f, 0.15f}};
+    for(auto& shape : shapes){
+        BloomFilter b(0.01, n, shape[0], shape[1]);
+        b.insertMany(views.data(), n);
+        stringstream packed;
+        auto start = chrono::steady_clock::now();
+        exportCompressed(b, packed);
+        auto coded = chrono::steady_clock::now();
+        BloomFilter* copy = importCompressed(packed, false);
+        auto decoded = chrono::steady_clock::now();
+        size_t falsePos = 0;
+        for(size_t j = 0; j < ops; j++){
+            falsePos += copy->find(missing[j]);
+        }
+        bool same = memcmp(copy->bt->words, b.bt->words, b.bt->nwords * 8) == 0;
+        double bytes = b.bt->nwords * 8.0;
+        printf("  c = %.0f, k = %u: %6.2f bits per key in memory, %6.2f sent, rate %.5f, "
+               "encode %.2f GB/s, decode %.2f GB/s%s\n", shape[0], b.numHash, 8.0 * bytes / n,
+               8.0 * packed.str().size() / n, double(falsePos) / ops,
+               bytes / chrono::duration<double>(coded - start).count() / 1e9,
+               bytes / chrono::duration<double>(decoded - coded).count() / 1e9, same ? "" : " (MISMATCH)");
+        delete copy;
+    }
+}
+
+//Measures how long it takes to make and delete an empty filter of the given size in bytes,
+//and how long the first pass of inserts takes, which is when the pages of a large bit array
+//are first touched.
+void benchCreate(unsigned long long bytes, BloomLayout layout){
+    double p = 0.01;
+    int n = (int) min(bytes * 8 / 9.585, 2e9);
+    auto start = chrono::steady_clock::now();
+    BloomFilter* b = new BloomFilter(p, n, 1.0, 1.0, layout);
+    auto made = chrono::steady_clock::now();
+    //one insert per 4 KB page of the bit array touches about every page once
+    size_t touches = max(bytes / 4096, (unsigned long long) 1);
+    char key[KEY_LEN];
+    for(size_t j = 0; j < touches; j++){
+        makeKey(j, key);
+        b->insert(key, KEY_LEN);
+    }
+    auto filled = chrono::steady_clock::now();
+    delete b;
+    auto end = chrono::steady_clock::now();
+    printf("  %s %8llu KB: create %10.3f ms, %8zu inserts %10.3f ms, delete %10.3f ms\n",
+           layout == BLOOM_CLASSIC ? "classic" : "blocked", bytes >> 10,
+           chrono::duration<double, milli>(made - start).count(), touches,
+           chrono::duration<double, milli>(filled - made).count(),
+           chrono::duration<double, milli>(end - filled).count());
+}
+
+//Measures how insert and find throughput of one shared concurrent filter scales with threads.
+//Every thread inserts its own share of n keys, then looks up its share of n inserted
+//and n missing keys. Thread counts double from 1 up to maxThreads.
+void benchThreads(int maxThreads, size_t ops){
+    int n = ops;
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    vector<string> missing = makeKeys(n, [](size_t j){ return MISSING | j; });
+    printf("Concurrent mode, blocked layout, n = %d\n", n);
+    for(int t = 1; t <= maxThreads; t *= 2){
+        BloomFilter b(0.01, n, 1.0, 1.0, BLOOM_BLOCKED, true);
+        vector<thread> workers;
+        auto start = chrono::steady_clock::now();
+        for(int w = 0; w < t; w++){
+            workers.push_back(thread([&b, &keys, n, t, w](){
+                for(int i = w; i < n; i += t){
+                    b.insert(keys[i]);
+                }
+            }));
+        }
+        for(thread& w : workers){
+            w.join();
+        }
+        workers.clear();
+        auto mid = chrono::steady_clock::now();
+        atomic<int> falseNeg(0);
+        atomic<int> falsePos(0);
+        for(int w = 0; w < t; w++){
+            workers.push_back(thread([&, w](){
+                int neg = 0;
+                int pos = 0;
+                for(int i = w; i < n; i += t){
+                    neg += !b.find(keys[i]);
+                    pos += b.find(missing[i]);
+                }
+                falseNeg += neg;
+                falsePos += pos;
+            }));
+        }
+        for(thread& w : workers){
+            w.join();
+        }
+        auto end = chrono::steady_clock::now();
+        double insertSec = chrono::duration<double>(mid - start).count();
+        double findSec = chrono::duration<double>(end - mid).count();
+        printf("  threads = %2d: insert %8.2f Mops/s, find %8.2f Mops/s, false negatives %d, false positive rate %.5f\n",
+               t, n / insertSec / 1e6, 2.0 * n / findSec / 1e6, falseNeg.load(), double(falsePos) / n);
+    }
+}
+
+//Measures lookups in a sharded filter with one shard per NUMA node, from threads pinned to
+//each node. "local" threads only look up keys whose shard is on their node (what
+//ShardedBloomFilter::partition is for), "remote" threads look up the keys of the next node.
+//The filter is sized for p = 1e-9, about 45 bits per key, so it doesn't fit in the caches.
+void benchShards(int maxThreads, size_t ops){
+    NumaTopology topology = NumaTopology::read();
+    int nodes = topology.nodes();
+    int n = ops;
+    ShardedBloomFilter b(1e-9, n, 0, BLOOM_BLOCKED, true);
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    for(int i = 0; i < n; i++){
+        b.insert(keys[i]);
+    }
+    vector<string_view> views(keys.begin(), keys.end());
+    vector<vector<size_t>> byNode;
+    b.partition(views.data(), n, byNode);
+    printf("Sharded filter, %d NUMA node(s), %d shards, n = %d\n", nodes, b.numShards, n);
+    if(nodes == 1){
+        printf("  only one node, so local and remote lookups use the same memory\n");
+    }
+    for(int remote = 0; remote < 2; remote++){
+        vector<thread> workers;
+        atomic<unsigned long long> lookups(0);
+        atomic<int> falseNeg(0);
+        auto start = chrono::steady_clock::now();
+        for(int node = 0; node < nodes; node++){
+            int threads = max(min((int) topology.nodeCpus[node].size(), maxThreads / nodes), 1);
+            const vector<size_t>& mine = byNode[(node + remote) % nodes];
+            for(int w = 0; w < threads; w++){
+                workers.push_back(thread([&, node, threads, w](){
+                    topology.pinToNode(node);
+                    int neg = 0;
+                    for(size_t i = w; i < mine.size(); i += threads){
+                        neg += !b.find(views[mine[i]]);
+                    }
+                    lookups += (mine.size() + threads - 1 - w) / threads;
+                    falseNeg += neg;
+                }));
+            }
+        }
+        for(thread& w : workers){
+            w.join();
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("  %-6s lookups: %8.2f Mops/s, false negatives %d\n", remote ? "remote" : "local",
+               lookups / sec / 1e6, falseNeg.load());
+    }
+}
+
+//Benchmarks lookups through a FilterServer running in another thread.
+//Each batch size is timed for about ops keys, sending one batch and waiting for its reply,
+//and then again with 16 batches sent before reading any reply.
+void benchServer(size_t ops){
+    int n = min(ops, (size_t) 1 << 24);
+    string path = "/tmp/benchmark-" + to_string(getpid()) + ".sock";
+    FilterServer server;
+    BloomFilter* b = new BloomFilter(0.01, n, 1, 1, BLOOM_BLOCKED);
+    vector<string> keys = makeKeys(n, [](size_t j){ return j; });
+    for(int i = 0; i < n; i++){
+        b->insert(keys[i]);
+    }
+    server.addFilter("bench", b);
+    if(!server.listenUnix(path.c_str())){
+        printf("Filter server: could not listen on %s\n", path.c_str());
+        return;
+    }
+    thread serverThread([&](){ server.run(); });
+    FilterClient client;
+    if(!client.connectUnix(path.c_str())){
+        printf("Filter server: could not connect to %s\n", path.c_str());
+        server.stop();
+        serverThread.join();
+        return;
+    }
+    vector<string_view> views(keys.begin(), keys.end());
+    vector<uint64_t> found(n / 64 + 1);
+    printf("Filter server over a Unix domain socket, n = %d\n", n);
+    for(int batch : {1, 16, 64, 1024}){
+        if(batch > n){
+            break;
+        }
+        for(int pipelined = 0; pipelined < 2; pipelined++){
+            int depth = pipelined ? 16 : 1;
+            size_t batches = max(ops / batch, (size_t) depth) / depth * depth;
+            int falseNeg = 0;
+            ServerReply reply;
+            auto start = chrono::steady_clock::now();
+            for(size_t i = 0; i < batches; i += depth){
+                for(int d = 0; d < depth; d++){
+                    client.queue(SERVER_FIND, "bench", &views[(i + d) * batch % (n - batch + 1)], batch);
+                }
+                client.flush();
+                for(int d = 0; d < depth; d++){
+                    client.receive(reply, found);
+                    for(int j = 0; j < batch; j++){
+                        falseNeg += !((found[j / 64] >> (j % 64)) & 1);
+                    }
+                }
+            }
+            double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            printf("    batch %5d %-10s %10.2f us/batch %10.1f ns/key, false negatives %d\n", batch,
+                   pipelined ? "pipelined" : "", ns / batches / 1e3, ns / batches / batch, falseNeg);
+        }
+    }
+    server.stop();
+    serverThread.join();
+}
+
+//Benchmarks incremental checkpoints of a filter of the given size in bytes, filled to what it
+//was sized for: checkpoints after 100, 1000 and 10000 more inserts (fsynced) against a full
+//snapshot of the same filter.
+void benchCheckpoint(unsigned long long bytes){
+    string path = "/tmp/benchmark-" + to_string(getpid()) + ".bloom";
+    int n = (int) (bytes * 8 / 9.585);
+    BloomFilter* b = new BloomFilter(0.01, n, 1, 1, BLOOM_BLOCKED);
+    vector<string> keys = makeKeys(n + 11100, [](size_t j){ return j; });
+    for(int i = 0; i < n; i++){
+        b->insert(keys[i]);
+    }
+    FilterCheckpointer* c = FilterCheckpointer::create(b, path.c_str());
+    if(c == NULL){
+        printf("Checkpoints: could not write %s\n", path.c_str());
+        delete b;
+        return;
+    }
+    printf("Checkpoints of a %llu KB filter (blocked, fsynced)\n", bytes >> 10);
+    int next = n;
+    for(int churn : {100, 1000, 10000}){
+        for(int i = 0; i < churn; i++){
+            b->insert(keys[next++]);
+        }
+        auto start = chrono::steady_clock::now();
+        c->checkpoint();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        printf("    %5d inserts: %8.2f ms, %6llu pages, %10llu bytes%s\n", churn, ms, c->lastPages, c->lastBytes,
+               c->lastCompacted ? " (compacted)" : "");
+    }
+    auto start = chrono::steady_clock::now();
+    c->compact();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("    full snapshot: %8.2f ms, %6llu pages, %10llu bytes\n", ms, c->lastPages, c->lastBytes);
+    delete c;
+    unlink(path.c_str());
+    unlink((path + ".log").c_str());
+}
+
+int main(int argc, char* argv[]){
+    unsigned long long maxBytes = 1ull << 30;
+    size_t ops = 1000000;
+    int maxThreads = max((int) thread::hardware_concurrency(), 1);
+    for(int i = 1; i + 1 < argc; i += 2){
+        string flag = argv[i];
+        if(flag == "--max-bytes"){
+            maxBytes = stoull(argv[i + 1]);
+        }else if(flag == "--ops"){
+            ops = stoull(argv[i + 1]);
+        }else if(flag == "--threads"){
+            maxThreads = stoi(argv[i + 1]);
+        }else{
+            cout << "Unknown option " << flag << endl;
+            return 1;
+        }
+    }
+    PerfCounter perf;
+    if(!perf.ok){
+        cout << "perf events are not available, cache misses will show as n/a" << endl;
+    }
+    unsigned long long sizes[] = {16ull << 10, 256ull << 10, 4ull << 20, 64ull << 20, 1ull << 30};
+    printf("Filter creation\n");
+    for(unsigned long long bytes : sizes){
+        if(bytes > maxBytes){
+            break;
+        }
+        benchCreate(bytes, BLOOM_CLASSIC);
+        benchCreate(bytes, BLOOM_BLOCKED);
+    }
+    for(unsigned long long bytes : sizes){
+        if(bytes > maxBytes){
+            break;
+        }
+        printf("Filter of %llu KB\n", bytes >> 10);
+        benchFilter(bytes, BLOOM_CLASSIC, ops, perf);
+        benchFilter(bytes, BLOOM_BLOCKED, ops, perf);
+        int n = (int) min(bytes * 8 / 9.585, 2e9);
+        if(n <= (1 << 24)){
+            benchFuse(n, ops, perf);
+            benchCuckoo(n, ops, perf);
+            benchCounting(n, ops, perf);
+            benchCompress(n, ops);
+        }
+    }
+    benchScalable((int) min(2 * ops, (size_t) 1 << 30), ops, perf);
+    benchAging((int) max(min(ops / 10, (size_t) 1 << 26), (size_t) 1000), perf);
+    benchThreads(maxThreads, ops);
+    benchShards(maxThreads, ops);
+    benchServer(ops);
+    for(int i = 4; i >= 0; i--){
+        if(sizes[i] <= min(maxBytes, 64ull << 20)){
+            benchCheckpoint(sizes[i]);
+            break;
+        }
+    }
+    return 0;
+}
@@ -7,51 +7,58 @@
 #include <time.h>  
 #include <utility> 
 #include<fstream>    
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <random>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 
 //Document write up:
 //String to int conversion:
-//For this I used the equation given in the instructions: x = d[0] * C^0 + d[1]*C^1 + ... + d[n]C^n.
-//For this I picked the value for C to be 53 because it the prime number which is roughly equal to the
-//size of unique letters(upper and lower).
-
-//I accounted for overflow by modding the sum by the max unsigned int number after each summation,
-//making the summation variable a long long, so no addition/multiplication of two ints could cause 
-//overflow, and by modding my C variable by the max unsigned int variable to ensure that c was never 
-//above 32 bits when it was used in the summation. C was also made as a long long for when it reached
-//above 32 bits prior to it being modded back down.
-
-//This prevents collisions between strings with the same letters in differing orders because the 
-//constant C is constantly being multiplied by itself each summation. Which means that not only 
-//the characters in a string matter, but also the order in which the appear.
-//In the case of 'reed' vs 'deer'
-//'reed' = 114*53^0 + 101*53^1 + 101*53^2 + 100^53^3 = 15176876
-//'deer' = 100*53^0 + 101*53^1 + 101*53^2 + 114^53^3 = 17261140
-//This shows that 'reed' and 'deer' wont collide unless the size of the bloom filter is the size of a 
-//factor which they both have. 
+//Keys used to be turned into a 32 bit number with x = d[0] * C^0 + d[1]*C^1 + ... + d[n]C^n,
+//C = 53, before being hashed. Nothing uses that any more since keys are hashed straight from
+//their bytes (see Bloom Filter Hashing), so the function is gone.
 
 //Bloom Filter Hashing:
-//The hash function I chose to model my family after is ((ax+b) mod p) mod m) (from the textbook p. 231)
-//Here a and b are randomly generated values where 1 <= a <= p-1 and 1 <= b <= p-1
-//x is the int equivalent of the string which needs to be added to the filter. (calculations for this shown above)
-//m is the size of the bloom filter 
-//p is the first prime number bigger than m
-//The point of a and b in the formula is to add extra variability to the function, so that it can
-//be used in a family. 
-//p is specifically a prime number, bigger than m, so that it will not have any common factors with
-//(ax + b) which can cause bias in hashing.
-//The mod m at the end is so that the value will be an index in the bloom filter.
-//This equation was utilized to make a family by changing the values of a and b to allow for different 
-//hashing functions. For example a function with a = 33490 and b = 35 would give completely different
-//values than a = 345 and b = 12345. And because the equation is universal, all equations derived
-//from the formula will also be universal.
-//To make the family I created an array of random pairs for a and b, each of which were used as their
-//own hash function.
+//Originally every hash function was ((ax + b) mod p) mod m from the textbook (p. 231) applied
+//to the 32 bit number from the string to int conversion. That walked the string with two
+//divisions per character, did three 64 bit modulo operations per hash function and
+//meant any two strings with the same 32 bit number always collided.
+//Now each string is hashed once into 64 bits with hashKey (modeled after wyhash), which
+//takes a seed so different seeds give different functions of the family.
+//The k indices come from that single hash by double hashing (Kirsch and Mitzenmacher):
+//g_i(x) = h1(x) + i * h2(x)
+//where h1 is the hash and h2 is the hash with its halves swapped (forced odd so it never
+//repeats an index early). They showed this keeps the same asymptotic false positive rate as
+//k independent hash functions.
+//g_i is mapped onto the bloom filter with a multiply and shift, (g_i * m) >> 64, which
+//needs neither a modulo nor a prime, so the constructor no longer searches for one.
+//The seed defaults to the fixed DEFAULT_SEED instead of a random one, so the same keys
+//always give the same filter, and a filter saved by one process can be used by another.
+//Because k rarely changes after a filter is made, the probe loop is a template on k (and
+//on the layout and concurrent mode) and the constructor picks the fully unrolled version
+//for k up to 16 once, instead of checking numHash and the layout on every probe.
 
 //Remove Hash Table Size:
 //I am assuming that roughly 10 percent of the input strings will be deleted. Based on that assumption
-//I made the Hash Table size the next highest prime number following 1/10th of the expected bloom filter
-//entries.
+//the Hash Table starts with room for 1/10th of the expected bloom filter entries. Because
+//find checks the table on every lookup it is a flat open addressing table instead of
+//linked lists, and it grows by itself if more strings than that get removed.
+//For very big filters the starting room is capped, since filling the control bytes of a table
+//for hundreds of millions of removes took longer than making the bit array itself.
+
+//Construction:
+//The bloom filter size used to be the next prime after the computed size, found by trial
+//division, and the bits were zeroed one at a time. The size no longer needs to be prime
+//(see Bloom Filter Hashing), and big bit arrays come zeroed from the kernel (see BitArray),
+//so making a filter takes about the same time whatever its size.
 
 //Results:
 //The pictures of the plots for testing are in the folder.
@@ -64,6 +71,12 @@
 //the probabilty of collisions. However, if the number of hash functions get too high, then after a while
 //the entire table will become full, which means that no matter what a string is, it will always think
 //it is in the table.
+//Tuning:
+//Instead of finding c and d from plots, filterTuner.h works out the size, k and layout for a
+//number of elements and a false positive rate, memory limit or lookup time from expectedFpr.
+//For p = 0.01 that's 9.6 bits per key with k = 7, which c = 1, d = 1 already comes to now
+//that k is rounded instead of cut down. The blocked layout needs more bits than the plain
+//Poisson model said: at p = 0.001 it is 17 bits per key, not 16 (see expectedFpr).
 
 
 
@@ -72,128 +85,866 @@
 using namespace std;
 
 //Constructor for the bloom filter
-BloomFilter::BloomFilter(double p, int m, float c, float d){
+BloomFilter::BloomFilter(double p, int m, float c, float d, BloomLayout layout, bool concurrent, uint64_t seed){
     //assigning values in the class to their corresponding parameters.
     pr = p;
     numElem = m;
+    this->layout = layout;
+    this->concurrent = concurrent;
+    numRemoved = 0;
    size = BloomFilterSize(p,m,c);
    //size = 10000;
-    bt = new bool[size];
-    for(int i = 0 ; i< size; i++){
-        bt[i] = false;
-    }
-    bool notPrime = true;
-    bool prime = true;
-    k = size;
-    //Finding the next prime number after the the bloom filters size
-    //Done in the constructor to avoid repeating the calclation.
-    while(notPrime){
-        prime = true;
-        k++;
-        for(int i = 2; i < sqrt(k);i++){
-            if(k%i == 0){
-                prime = false;
-            }
-        }
-        if(prime){
-            notPrime = false;
+    //The blocked layout needs a whole number of blocks.
+    if(layout == BLOOM_BLOCKED){
+        size = ((size + BLOCK_BITS - 1) / BLOCK_BITS) * BLOCK_BITS;
+        if(size == 0){
+            size = BLOCK_BITS;
         }
     }
+    bt = new BitArray(size);
     //Number of hash functions will be the same regardless of scalar 
     //multiplier on the bloom filter size.
-    int ans = numHashFunctions(size/c, numElem, d);
-    srand (time(NULL));
-    int a = 0;
-    int b = 0;
-    pair<int,int> pa;
-    //filling the family hash function with a pair of two random numbers from 1 to k-1 using the rand() method
-    //These pairs are used to calculate the hashing function in the hash method.
-    for(int i = 0; i < ans; i++){
-        a = (rand() % k-1) + 1;
-        b = (rand() % k-1) + 1;
-        pa = make_pair(a,b);
-        hFunc.push_back(pa);
-    }
-    //Sets the remove hash table size to the next prime number after 10th of the expected entries.
-    q = numElem/10;
-    notPrime = true;
-    prime = true;
-    while(notPrime){
-        prime = true;
-        q++;
-        for(int i = 2; i < sqrt(q);i++){
-            if(q%i == 0){
-                prime = false;
-            }
-        }
-        if(prime){
-            notPrime = false;
-        }
-    }
+    numHash = numHashFunctions(size/c, numElem, d);
+    //the seed picks which function of the family the key hash is
+    this->seed = seed;
+    pickProbeLoops();
+#if BLOOM_STATS
+    counters = new BloomCounters[concurrent ? STATS_SLOTS : 1]();
+#endif
+    //Sets the remove hash table size for a 10th of the expected entries, up to REMOVE_TABLE_START.
+    //It grows if it needs to.
+    q = min(numElem/10, (unsigned int) REMOVE_TABLE_START);
     ht = new HashTable(q); 
 }
 
+//Constructor for a filter with an exact size, number of hash functions and seed.
+//Used when those are already known, like when opening a saved filter.
+BloomFilter::BloomFilter(unsigned long long size, unsigned int numHash, uint64_t seed, BloomLayout layout,
+                         bool concurrent, BitArray* bits){
+    pr = 0;
+    numElem = 0;
+    this->layout = layout;
+    this->concurrent = concurrent;
+    numRemoved = 0;
+    if(layout == BLOOM_BLOCKED){
+        size = ((size + BLOCK_BITS - 1) / BLOCK_BITS) * BLOCK_BITS;
+    }
+    if(size == 0){
+        size = layout == BLOOM_BLOCKED ? BLOCK_BITS : 1;
+    }
+    this->size = size;
+    this->numHash = numHash > 0 ? numHash : 1;
+    this->seed = seed;
+    bt = bits != NULL ? bits : new BitArray(size);
+    pickProbeLoops();
+#if BLOOM_STATS
+    counters = new BloomCounters[concurrent ? STATS_SLOTS : 1]();
+#endif
+    q = 0;
+    ht = new HashTable(q);
+}
+
 //inserts a string into the bloom filter
-void BloomFilter::insert(string element){
+void BloomFilter::insert(string_view element){
+    //hashes the string once, every hash function is derived from this
+    insertHashed(element, keyHash(element));
+}
+
+//inserts an element whose key hash is already known.
+void BloomFilter::insertHashed(string_view element, uint64_t elem){
+    countInserts(1);
     //if a string already exists in the bloom filter insert will not do anything
-    if(!(find(element))){
+    //In concurrent mode another thread could set the bits between the check and the
+    //write, so the check is skipped. Setting a bit twice does nothing anyway.
+    if(concurrent || isRemoved(element) || !(this->*testFn)(elem)){
         //If an element is added to the bloom filter it has to be removed from the second hash table
-        ht->remove(element);
-        int index = 0;
-        //converts the string to an int so it can be passed into the hash function
-        unsigned int elem = strToInt(element);
+        clearRemoved(element);
         //For every hash function, the method will change 1 index in the bloom filter to 1, unless it is already 1.
         //The specific indices are decided by the hashing function.
-        for(int i = 0; i < hFunc.size(); i++){
-            index = hash(elem,i);
-            bt[index] = true;
-        }
+        (this->*setFn)(elem);
     }
 }
 
 //checks if an element is in the bloom filter
-bool BloomFilter::find(string element){
-    int index = 0;
-    //converts the element into a string for the hash function.
-    unsigned int elem = strToInt(element);
+bool BloomFilter::find(string_view element){
+    //hashes the string once, every hash function is derived from this
+    return findHashed(element, keyHash(element));
+}
+
+//checks if an element whose key hash is already known is in the bloom filter
+bool BloomFilter::findHashed(string_view element, uint64_t elem){
     //Will return false if the element exists in the removed hash table
-    bool isThere = ht->find(element);
+    bool isThere = isRemoved(element);
     if(isThere){
+        countLookups(1, 0, 1);
         return false;
     }
     //checks if each hash function says the element is in the bloom filter
     //If any of them say it is not then the element doesn't exist in the bloom filter
-    for(int i = 0; i < hFunc.size(); i++){
-        index = hash(elem,i);
-        if(bt[index] == 0){
+    bool found = (this->*testFn)(elem);
+    countLookups(1, found, 0);
+    return found;
+}
+
+//the same as find, but not counted in the statistics
+bool BloomFilter::contains(string_view element){
+    return !isRemoved(element) && (this->*testFn)(keyHash(element));
+}
+
+//checks the bits of a key hash.
+//Classic layout stops at the first 0 bit, since each probe is probably another cache miss.
+//In the blocked layout every probe is in the same cache line, so all of them are checked
+//without branching.
+template <unsigned int K, int L, bool C>
+bool BloomFilter::testBits(uint64_t element){
+    const unsigned int k = K > 0 ? K : numHash;
+    if(L == BLOOM_BLOCKED){
+        uint64_t base = reduceRange(element, size / BLOCK_BITS) * BLOCK_BITS;
+        bool all = true;
+        #pragma GCC unroll 16
+        for(unsigned int i = 0; i < k; i++){
+            uint64_t index = blockedProbe(element, i, base);
+            all &= C ? bt->testAtomic(index) : bt->test(index);
+        }
+        return all;
+    }
+    #pragma GCC unroll 16
+    for(unsigned int i = 0; i < k; i++){
+        uint64_t index = classicProbe(element, i, size);
+        if(!(C ? bt->testAtomic(index) : bt->test(index))){
             return false;
         }
     }
     return true;
 }
 
+//sets the bits of a key hash.
+template <unsigned int K, int L, bool C>
+void BloomFilter::setBits(uint64_t element){
+    const unsigned int k = K > 0 ? K : numHash;
+    uint64_t base = L == BLOOM_BLOCKED ? reduceRange(element, size / BLOCK_BITS) * BLOCK_BITS : 0;
+    #pragma GCC unroll 16
+    for(unsigned int i = 0; i < k; i++){
+        uint64_t index = L == BLOOM_BLOCKED ? blockedProbe(element, i, base) : classicProbe(element, i, size);
+        if(C){
+            bt->setAtomic(index);
+        }else{
+            bt->set(index);
+        }
+    }
+}
+
+typedef bool (BloomFilter::*TestFn)(uint64_t element);
+typedef void (BloomFilter::*SetFn)(uint64_t element);
+
+//Tables of the probe loops for k = 1 to 16, one table for each layout and mode.
+//Any other k uses the K = 0 version which loops numHash times.
+template <int L, bool C, size_t... Ks>
+static void pickLoops(unsigned int k, TestFn& test, SetFn& set, index_sequence<Ks...>){
+    static const TestFn tests[] = {&BloomFilter::testBits<Ks + 1, L, C>...};
+    static const SetFn sets[] = {&BloomFilter::setBits<Ks + 1, L, C>...};
+    if(k >= 1 && k <= sizeof...(Ks)){
+        test = tests[k - 1];
+        set = sets[k - 1];
+    }else{
+        test = &BloomFilter::testBits<0, L, C>;
+        set = &BloomFilter::setBits<0, L, C>;
+    }
+}
+
+//points testFn and setFn at the probe loops for this filter's k, layout and mode.
+void BloomFilter::pickProbeLoops(){
+    typedef make_index_sequence<16> upTo16;
+    if(layout == BLOOM_BLOCKED){
+        if(concurrent){
+            pickLoops<BLOOM_BLOCKED, true>(numHash, testFn, setFn, upTo16());
+        }else{
+            pickLoops<BLOOM_BLOCKED, false>(numHash, testFn, setFn, upTo16());
+        }
+    }else{
+        if(concurrent){
+            pickLoops<BLOOM_CLASSIC, true>(numHash, testFn, setFn, upTo16());
+        }else{
+            pickLoops<BLOOM_CLASSIC, false>(numHash, testFn, setFn, upTo16());
+        }
+    }
+}
+
+//checks if element is in the remove hash table.
+//Most filters never have anything removed, so the table is only searched when it has elements.
+//In concurrent mode the table is searched under the lock.
+bool BloomFilter::isRemoved(string_view element){
+    if(!concurrent){
+        return ht->count > 0 && ht->find(element);
+    }
+    if(numRemoved.load(memory_order_acquire) == 0){
+        return false;
+    }
+    lock_guard<mutex> guard(htLock);
+    return ht->find(element);
+}
+
+//removes element from the remove hash table, used when it is inserted again.
+void BloomFilter::clearRemoved(string_view element){
+    if(!concurrent){
+        if(ht->count > 0){
+            ht->remove(element);
+        }
+        return;
+    }
+    if(numRemoved.load(memory_order_acquire) == 0){
+        return;
+    }
+    lock_guard<mutex> guard(htLock);
+    ht->remove(element);
+    numRemoved.store(ht->count, memory_order_release);
+}
+
+//Versions of insert, find and remove for keys given as raw bytes.
+void BloomFilter::insert(const void* key, size_t len){
+    insert(string_view((const char*) key, len));
+}
+
+bool BloomFilter::find(const void* key, size_t len){
+    return find(string_view((const char*) key, len));
+}
+
+void BloomFilter::remove(const void* key, size_t len){
+    remove(string_view((const char*) key, len));
+}
+
+//Number of keys findMany and insertMany work on at a time.
+//All of a batch's keys are hashed and their probe addresses prefetched before any
+//bit is tested, so the cache misses of the batch overlap instead of happening one by one.
+const size_t BATCH = 64;
+
+//Kernels for testing a batch of keys. Each returns a mask with bit j set if key j
+//of the batch had all of its bits set.
+//Blocked layout: blocks[j] is the first word of key j's block and masks holds 8 words
+//per key with the key's k bits set.
+//Classic layout: probes holds k bit indices per key.
+typedef uint64_t (*BlockedKernel)(const uint64_t* words, const uint64_t* blocks, const uint64_t* masks, size_t n);
+typedef uint64_t (*ClassicKernel)(const uint64_t* words, const uint64_t* probes, size_t n, unsigned int k);
+
+//The scalar kernels read the filter with relaxed atomic loads (plain loads on x86),
+//so they are also the kernels used in concurrent mode while other threads insert.
+static uint64_t blockedScalar(const uint64_t* words, const uint64_t* blocks, const uint64_t* masks, size_t n){
+    uint64_t hits = 0;
+    for(size_t j = 0; j < n; j++){
+        const uint64_t* block = words + blocks[j];
+        const uint64_t* mask = masks + 8 * j;
+        uint64_t missing = 0;
+        for(int w = 0; w < 8; w++){
+            missing |= mask[w] & ~__atomic_load_n(&block[w], __ATOMIC_RELAXED);
+        }
+        hits |= uint64_t(missing == 0) << j;
+    }
+    return hits;
+}
+
+static uint64_t classicScalar(const uint64_t* words, const uint64_t* probes, size_t n, unsigned int k){
+    uint64_t hits = 0;
+    for(size_t j = 0; j < n; j++){
+        const uint64_t* idx = probes + k * j;
+        bool all = true;
+        for(unsigned int i = 0; i < k && all; i++){
+            all = (__atomic_load_n(&words[idx[i] >> 6], __ATOMIC_RELAXED) >> (idx[i] & 63)) & 1;
+        }
+        hits |= uint64_t(all) << j;
+    }
+    return hits;
+}
+
+#if defined(__x86_64__)
+//AVX2 kernels. A block is tested as two 256 bit halves with vptest, and the classic
+//layout gathers 4 probe words at a time.
+__attribute__((target("avx2")))
+static uint64_t blockedAvx2(const uint64_t* words, const uint64_t* blocks, const uint64_t* masks, size_t n){
+    uint64_t hits = 0;
+    for(size_t j = 0; j < n; j++){
+        const __m256i* block = (const __m256i*)(words + blocks[j]);
+        const __m256i* mask = (const __m256i*)(masks + 8 * j);
+        int lo = _mm256_testc_si256(_mm256_load_si256(block), _mm256_load_si256(mask));
+        int hi = _mm256_testc_si256(_mm256_load_si256(block + 1), _mm256_load_si256(mask + 1));
+        hits |= uint64_t(lo & hi) << j;
+    }
+    return hits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t classicAvx2(const uint64_t* words, const uint64_t* probes, size_t n, unsigned int k){
+    uint64_t hits = 0;
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i low6 = _mm256_set1_epi64x(63);
+    for(size_t j = 0; j < n; j++){
+        const uint64_t* idx = probes + k * j;
+        __m256i missing = _mm256_setzero_si256();
+        unsigned int i = 0;
+        for(; i + 4 <= k; i += 4){
+            __m256i bit = _mm256_loadu_si256((const __m256i*)(idx + i));
+            __m256i word = _mm256_i64gather_epi64((const long long*)words, _mm256_srli_epi64(bit, 6), 8);
+            __m256i mask = _mm256_sllv_epi64(one, _mm256_and_si256(bit, low6));
+            missing = _mm256_or_si256(missing, _mm256_andnot_si256(word, mask));
+        }
+        bool all = _mm256_testz_si256(missing, missing);
+        for(; i < k && all; i++){
+            all = (words[idx[i] >> 6] >> (idx[i] & 63)) & 1;
+        }
+        hits |= uint64_t(all) << j;
+    }
+    return hits;
+}
+
+//AVX-512 kernels. A whole block is one register and the classic layout gathers 8 probe words at a time.
+__attribute__((target("avx512f")))
+static uint64_t blockedAvx512(const uint64_t* words, const uint64_t* blocks, const uint64_t* masks, size_t n){
+    uint64_t hits = 0;
+    for(size_t j = 0; j < n; j++){
+        __m512i block = _mm512_load_si512(words + blocks[j]);
+        __m512i mask = _mm512_load_si512(masks + 8 * j);
+        __m512i missing = _mm512_andnot_si512(block, mask);
+        hits |= uint64_t(_mm512_test_epi64_mask(missing, missing) == 0) << j;
+    }
+    return hits;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t classicAvx512(const uint64_t* words, const uint64_t* probes, size_t n, unsigned int k){
+    uint64_t hits = 0;
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i low6 = _mm512_set1_epi64(63);
+    for(size_t j = 0; j < n; j++){
+        const uint64_t* idx = probes + k * j;
+        __m512i missing = _mm512_setzero_si512();
+        unsigned int i = 0;
+        for(; i + 8 <= k; i += 8){
+            __m512i bit = _mm512_loadu_si512(idx + i);
+            __m512i word = _mm512_i64gather_epi64(_mm512_srli_epi64(bit, 6), words, 8);
+            __m512i mask = _mm512_sllv_epi64(one, _mm512_and_si512(bit, low6));
+            missing = _mm512_or_si512(missing, _mm512_andnot_si512(word, mask));
+        }
+        bool all = _mm512_test_epi64_mask(missing, missing) == 0;
+        for(; i < k && all; i++){
+            all = (words[idx[i] >> 6] >> (idx[i] & 63)) & 1;
+        }
+        hits |= uint64_t(all) << j;
+    }
+    return hits;
+}
+#endif
+
+//picks the widest kernels the cpu supports, checked once the first time they are needed.
+static BlockedKernel blockedKernel(){
+#if defined(__x86_64__)
+    static BlockedKernel kernel = __builtin_cpu_supports("avx512f") ? blockedAvx512
+        : __builtin_cpu_supports("avx2") ? blockedAvx2 : blockedScalar;
+    return kernel;
+#else
+    return blockedScalar;
+#endif
+}
+
+static ClassicKernel classicKernel(){
+#if defined(__x86_64__)
+    static ClassicKernel kernel = __builtin_cpu_supports("avx512f") ? classicAvx512
+        : __builtin_cpu_supports("avx2") ? classicAvx2 : classicScalar;
+    return kernel;
+#else
+    return classicScalar;
+#endif
+}
+
+//checks a range of keys at once.
+//The keys are worked on in batches of 64: every key of a batch is hashed and its
+//probe words prefetched, then the kernel tests the whole batch and its hit mask is
+//the batch's word of found.
+void BloomFilter::findMany(const string_view* keys, size_t n, uint64_t* found){
+    //blocks and masks for the blocked layout, 64 byte aligned for the vector loads
+    alignas(64) uint64_t masks[BATCH * 8];
+    uint64_t blocks[BATCH];
+    //k probes per key for the classic layout
+    vector<uint64_t> probes;
+    if(layout == BLOOM_CLASSIC){
+        probes.resize(BATCH * numHash);
+    }
+    for(size_t start = 0; start < n; start += BATCH){
+        size_t count = min(BATCH, n - start);
+        if(layout == BLOOM_BLOCKED){
+            memset(masks, 0, sizeof(masks));
+            for(size_t j = 0; j < count; j++){
+                uint64_t elem = keyHash(keys[start + j]);
+                unsigned long long base = blockBase(elem);
+                blocks[j] = base >> 6;
+                __builtin_prefetch(bt->words + blocks[j]);
+                for(unsigned int i = 0; i < numHash; i++){
+                    unsigned long long bit = probe(elem,i,base) - base;
+                    masks[8 * j + (bit >> 6)] |= uint64_t(1) << (bit & 63);
+                }
+            }
+            found[start / BATCH] = (concurrent ? blockedScalar : blockedKernel())(bt->words, blocks, masks, count);
+        }else{
+            for(size_t j = 0; j < count; j++){
+                uint64_t elem = keyHash(keys[start + j]);
+                for(unsigned int i = 0; i < numHash; i++){
+                    probes[numHash * j + i] = hash(elem,i);
+                    __builtin_prefetch(bt->words + (probes[numHash * j + i] >> 6));
+                }
+            }
+            found[start / BATCH] = (concurrent ? classicScalar : classicKernel())(bt->words, probes.data(), count, numHash);
+        }
+        //keys in the removed hash table are not in the filter
+        uint64_t tombstoneHits = 0;
+        if((concurrent ? numRemoved.load(memory_order_acquire) : ht->count) > 0){
+            for(size_t j = 0; j < count; j++){
+                if(((found[start / BATCH] >> j) & 1) && isRemoved(keys[start + j])){
+                    found[start / BATCH] &= ~(uint64_t(1) << j);
+                    tombstoneHits++;
+                }
+            }
+        }
+        countLookups(count, __builtin_popcountll(found[start / BATCH]), tombstoneHits);
+    }
+}
+
+//inserts a range of keys at once.
+//Setting bits that are already set does nothing, so unlike insert this does not
+//look the key up first. Each batch is hashed and prefetched before any bit is set.
+void BloomFilter::insertMany(const string_view* keys, size_t n){
+    countInserts(n);
+    vector<uint64_t> probes(BATCH * numHash);
+    for(size_t start = 0; start < n; start += BATCH){
+        size_t count = min(BATCH, n - start);
+        for(size_t j = 0; j < count; j++){
+            uint64_t elem = keyHash(keys[start + j]);
+            unsigned long long base = blockBase(elem);
+            for(unsigned int i = 0; i < numHash; i++){
+                probes[numHash * j + i] = probe(elem,i,base);
+                __builtin_prefetch(bt->words + (probes[numHash * j + i] >> 6), 1);
+            }
+        }
+        for(size_t j = 0; j < count; j++){
+            //If an element is added to the bloom filter it has to be removed from the second hash table
+            if((concurrent ? numRemoved.load(memory_order_acquire) : ht->count) > 0){
+                clearRemoved(keys[start + j]);
+            }
+            for(unsigned int i = 0; i < numHash; i++){
+                if(concurrent){
+                    bt->setAtomic(probes[numHash * j + i]);
+                }else{
+                    bt->set(probes[numHash * j + i]);
+                }
+            }
+        }
+    }
+}
+
 //removes an element from the bloom filter by adding it to the secondary hash table
-void BloomFilter::remove(string element){
+void BloomFilter::remove(string_view element){
     //only adds an element to the hash table if it already exists in the bloom filter.
     //If it is not in the bloom filter, the function doesn't do anything because there 
     //is nothing to remove.
-    bool x = find(element);
+    countRemoves(1);
+    bool x = contains(element);
     if(x){
-        ht->insert(element);
+        if(concurrent){
+            lock_guard<mutex> guard(htLock);
+            ht->insert(element);
+            numRemoved.store(ht->count, memory_order_release);
+        }else{
+            ht->insert(element);
+        }
     }
 }
 //bloom filter destructor.
 BloomFilter::~BloomFilter(){
     //deletes the bloom filter array and the secondary hash table
-    delete[] bt;
+    delete bt;
     delete ht;
+#if BLOOM_STATS
+    delete[] counters;
+#endif
+}
+
+//number of keys in a removed keys section (see BloomFileHeader)
+static uint64_t removedCount(string_view section){
+    uint64_t count = 0;
+    size_t pos = 0;
+    while(pos + 4 <= section.size()){
+        uint32_t len;
+        memcpy(&len, section.data() + pos, 4);
+        if(len > section.size() - pos - 4){
+            break;
+        }
+        pos += 4 + len;
+        count++;
+    }
+    return count;
+}
+
+//writes the filter to a file.
+//The header goes first, then the bit array starting at BLOOM_DATA_OFFSET, then the keys
+//in the remove hash table so removed keys stay removed when the filter is opened.
+bool BloomFilter::save(const char* path){
+    string removed;
+    if(concurrent){
+        lock_guard<mutex> guard(htLock);
+        removed = removedSection();
+    }else{
+        removed = removedSection();
+    }
+    BloomFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BLOOM_MAGIC, 8);
+    header.version = BLOOM_VERSION;
+    header.layout = layout;
+    header.size = size;
+    header.numHash = numHash;
+    header.seed = seed;
+    header.numElem = numElem;
+    header.numRemoved = removedCount(removed);
+    header.removedBytes = removed.size();
+    header.bitsChecksum = hashKey(bt->words, bt->nwords * 8, 0);
+    header.headerChecksum = hashKey(&header, offsetof(BloomFileHeader, headerChecksum), 0);
+    ofstream out(path, ios::binary | ios::trunc);
+    if(!out.is_open()){
+        return false;
+    }
+    string padding(BLOOM_DATA_OFFSET - sizeof(header), '\0');
+    out.write((const char*) &header, sizeof(header));
+    out.write(padding.data(), padding.size());
+    out.write((const char*) bt->words, bt->nwords * 8);
+    out.write(removed.data(), removed.size());
+    out.close();
+    return !out.fail();
+}
+
+//opens a filter saved with save.
+//The header is read and checked first, then the whole file is mapped and the bit array
+//is used straight from the mapping, so opening takes the same time for any size of filter.
+BloomFilter* BloomFilter::open(const char* path, bool verify){
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0){
+        return NULL;
+    }
+    struct stat st;
+    BloomFileHeader header;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < BLOOM_DATA_OFFSET ||
+       pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)){
+        close(fd);
+        return NULL;
+    }
+    //the checksum only catches accidents, so the sizes are checked against the file's before
+    //any arithmetic is done with them, or a made up header could wrap it around
+    uint64_t avail = st.st_size - BLOOM_DATA_OFFSET;
+    bool valid = memcmp(header.magic, BLOOM_MAGIC, 8) == 0 && header.version == BLOOM_VERSION &&
+                 header.headerChecksum == hashKey(&header, offsetof(BloomFileHeader, headerChecksum), 0) &&
+                 header.layout <= BLOOM_BLOCKED && header.numHash > 0 && header.size > 0 &&
+                 (header.layout != BLOOM_BLOCKED || header.size % BLOCK_BITS == 0) &&
+                 header.size / 64 <= avail / 8 && header.removedBytes <= avail;
+    uint64_t nwords = (header.size + 63) / 64;
+    valid = valid && nwords * 8 == avail - header.removedBytes;
+    if(!valid){
+        close(fd);
+        return NULL;
+    }
+    //private and writable: pages are shared with every other process mapping the file until
+    //something is inserted, and then only the written page is copied
+    void* mapping = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED){
+        return NULL;
+    }
+    if(verify && hashKey((char*) mapping + BLOOM_DATA_OFFSET, nwords * 8, 0) != header.bitsChecksum){
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+    BitArray* bits = new BitArray(header.size, mapping, st.st_size, BLOOM_DATA_OFFSET);
+    BloomFilter* b = new BloomFilter(header.size, header.numHash, header.seed, (BloomLayout) header.layout, false, bits);
+    b->numElem = header.numElem;
+    //putting the removed keys back in the remove hash table
+    b->loadRemoved((const char*) mapping + BLOOM_DATA_OFFSET + nwords * 8, header.removedBytes);
+    return b;
+}
+
+//packs every removed key as a 32 bit length and the key's bytes
+string BloomFilter::removedSection(){
+    string removed;
+    for(int i = 0; i < ht->m; i++){
+        if(ht->ctrl[i] >= 0){
+            uint32_t len = ht->slots[i].len;
+            removed.append((const char*) &len, 4);
+            removed.append(ht->arena.data() + ht->slots[i].offset, len);
+        }
+    }
+    return removed;
+}
+
+//empties the remove hash table and fills it with the keys of a removed keys section.
+//A key cut short at the end of the section is left out.
+void BloomFilter::loadRemoved(const char* section, size_t bytes){
+    const char* end = section + bytes;
+    HashTable* table = new HashTable(removedCount(string_view(section, bytes)));
+    while(section + 4 <= end){
+        uint32_t len;
+        memcpy(&len, section, 4);
+        section += 4;
+        if(len > (size_t) (end - section)){
+            break;
+        }
+        table->insert(string_view(section, len));
+        section += len;
+    }
+    if(concurrent){
+        lock_guard<mutex> guard(htLock);
+        swap(ht, table);
+        numRemoved.store(ht->count, memory_order_release);
+    }else{
+        swap(ht, table);
+        numRemoved = ht->count;
+    }
+    delete table;
+}
+
+//Kernels for merging bit arrays, dst[i] = dst[i] | src[i] or dst[i] & src[i] for n words.
+//Picked at runtime like the lookup kernels. Merging is limited by memory bandwidth, so the
+//point of the vector versions is to keep up with it using as few instructions as possible.
+typedef void (*MergeKernel)(uint64_t* dst, const uint64_t* src, size_t n);
+
+static void orScalar(uint64_t* dst, const uint64_t* src, size_t n){
+    for(size_t i = 0; i < n; i++){
+        dst[i] |= src[i];
+    }
+}
+
+static void andScalar(uint64_t* dst, const uint64_t* src, size_t n){
+    for(size_t i = 0; i < n; i++){
+        dst[i] &= src[i];
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static void orAvx2(uint64_t* dst, const uint64_t* src, size_t n){
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(a, b));
+    }
+    orScalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void andAvx2(uint64_t* dst, const uint64_t* src, size_t n){
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_and_si256(a, b));
+    }
+    andScalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void orAvx512(uint64_t* dst, const uint64_t* src, size_t n){
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m512i a = _mm512_loadu_si512(dst + i);
+        __m512i b = _mm512_loadu_si512(src + i);
+        _mm512_storeu_si512(dst + i, _mm512_or_si512(a, b));
+    }
+    orScalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void andAvx512(uint64_t* dst, const uint64_t* src, size_t n){
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m512i a = _mm512_loadu_si512(dst + i);
+        __m512i b = _mm512_loadu_si512(src + i);
+        _mm512_storeu_si512(dst + i, _mm512_and_si512(a, b));
+    }
+    andScalar(dst + i, src + i, n - i);
+}
+#endif
+
+static MergeKernel orKernel(){
+#if defined(__x86_64__)
+    static MergeKernel kernel = __builtin_cpu_supports("avx512f") ? orAvx512
+        : __builtin_cpu_supports("avx2") ? orAvx2 : orScalar;
+    return kernel;
+#else
+    return orScalar;
+#endif
+}
+
+static MergeKernel andKernel(){
+#if defined(__x86_64__)
+    static MergeKernel kernel = __builtin_cpu_supports("avx512f") ? andAvx512
+        : __builtin_cpu_supports("avx2") ? andAvx2 : andScalar;
+    return kernel;
+#else
+    return andScalar;
+#endif
+}
+
+//filters can be merged if their bits mean the same thing
+bool BloomFilter::compatible(BloomFilter& other){
+    return size == other.size && numHash == other.numHash && seed == other.seed && layout == other.layout;
+}
+
+//union with one other filter
+bool BloomFilter::unionWith(BloomFilter& other){
+    BloomFilter* others[1] = {&other};
+    return unionWith(others, 1);
+}
+
+//union with many filters.
+//The remove hash tables are fixed up first, while the bits still say which filter had what:
+//a key removed from one filter stays removed only if the other filters don't have it, and
+//this filter's removed keys which another filter has come back.
+bool BloomFilter::unionWith(BloomFilter** others, size_t count){
+    for(size_t i = 0; i < count; i++){
+        if(!compatible(*others[i])){
+            return false;
+        }
+    }
+    vector<string> stillRemoved;
+    for(size_t i = 0; i < count; i++){
+        if(others[i]->ht->count == 0){
+            continue;
+        }
+        for(const string& key : others[i]->ht->keys()){
+            bool present = contains(key);
+            for(size_t j = 0; j < count && !present; j++){
+                present = others[j]->contains(key);
+            }
+            if(!present){
+                stillRemoved.push_back(key);
+            }
+        }
+    }
+    if(ht->count > 0){
+        for(const string& key : ht->keys()){
+            for(size_t j = 0; j < count; j++){
+                if(others[j]->contains(key)){
+                    ht->remove(key);
+                    break;
+                }
+            }
+        }
+    }
+    //256 KB of words at a time, which stays in the L2 cache while every filter is OR-ed in
+    const size_t TILE = 32768;
+    MergeKernel kernel = orKernel();
+    for(size_t start = 0; start < bt->nwords; start += TILE){
+        size_t n = min(TILE, (size_t)(bt->nwords - start));
+        for(size_t i = 0; i < count; i++){
+            kernel(bt->words + start, others[i]->bt->words + start, n);
+        }
+    }
+    bt->markAllDirty();
+    for(const string& key : stillRemoved){
+        ht->insert(key);
+    }
+    numRemoved = ht->count;
+    return true;
+}
+
+//intersection with another filter.
+//Every key removed from either filter is removed from the result.
+bool BloomFilter::intersectWith(BloomFilter& other){
+    if(!compatible(other)){
+        return false;
+    }
+    andKernel()(bt->words, other.bt->words, bt->nwords);
+    bt->markAllDirty();
+    if(other.ht->count > 0){
+        for(const string& key : other.ht->keys()){
+            ht->insert(key);
+        }
+    }
+    numRemoved = ht->count;
+    return true;
+}
+
+//estimates the number of elements from the fill of the bit array.
+double BloomFilter::estimateCount(){
+    double set = bt->popcount();
+    if(set >= size){
+        //every bit is set so there is no telling how many elements there are
+        return INFINITY;
+    }
+    return -(double(size) / numHash) * log(1 - set / size);
+}
+
+//Snapshot of the filter's statistics.
+//The false positive rate of a key never inserted is the chance all k of its bits are set.
+//In the classic layout that is (set bits / size)^k. In the blocked layout all k bits are in
+//one block, so it is the average over the blocks of (set bits in the block / 512)^k, which
+//is higher than the classic formula because some blocks fill up more than others.
+BloomStats BloomFilter::stats(){
+    BloomStats st;
+    memset(&st, 0, sizeof(st));
+#if BLOOM_STATS
+    for(int i = 0; i < (concurrent ? STATS_SLOTS : 1); i++){
+        st.inserts += __atomic_load_n(&counters[i].inserts, __ATOMIC_RELAXED);
+        st.lookups += __atomic_load_n(&counters[i].lookups, __ATOMIC_RELAXED);
+        st.positives += __atomic_load_n(&counters[i].positives, __ATOMIC_RELAXED);
+        st.tombstoneHits += __atomic_load_n(&counters[i].tombstoneHits, __ATOMIC_RELAXED);
+        st.removes += __atomic_load_n(&counters[i].removes, __ATOMIC_RELAXED);
+    }
+    st.negatives = st.lookups - st.positives;
+#endif
+    if(concurrent){
+        lock_guard<mutex> guard(htLock);
+        st.tombstones = ht->count;
+    }else{
+        st.tombstones = ht->count;
+    }
+    st.size = size;
+    st.numHash = numHash;
+    if(layout == BLOOM_BLOCKED){
+        //(j / 512)^k for every count j a block can have
+        vector<double> blockFpr(BLOCK_BITS + 1);
+        for(int j = 0; j <= BLOCK_BITS; j++){
+            blockFpr[j] = pow(double(j) / BLOCK_BITS, numHash);
+        }
+        unsigned long long blocks = size / BLOCK_BITS;
+        double total = 0;
+        for(unsigned long long b = 0; b < blocks; b++){
+            unsigned long long set = popcountWords(bt->words + b * (BLOCK_BITS / 64), BLOCK_BITS / 64);
+            st.bitsSet += set;
+            total += blockFpr[set];
+        }
+        st.estimatedFpr = blocks > 0 ? total / blocks : 0;
+    }else{
+        st.bitsSet = bt->popcount();
+        st.estimatedFpr = pow(double(st.bitsSet) / size, numHash);
+    }
+    st.fillRatio = double(st.bitsSet) / size;
+    st.estimatedCount = st.bitsSet >= size ? INFINITY : -(double(size) / numHash) * log(1 - st.fillRatio);
+    return st;
+}
+
+//sets every operation count back to 0
+void BloomFilter::resetStats(){
+#if BLOOM_STATS
+    for(int i = 0; i < (concurrent ? STATS_SLOTS : 1); i++){
+        __atomic_store_n(&counters[i].inserts, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&counters[i].lookups, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&counters[i].positives, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&counters[i].tombstoneHits, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&counters[i].removes, 0, __ATOMIC_RELAXED);
+    }
+#endif
 }
 
 //prints out the bloom filter array
 //used for testing
 void BloomFilter::print(){
-    for(int i = 0; i < size; i++){
-        cout  << i << "," << bt[i] << " ";
+    for(unsigned long long i = 0; i < size; i++){
+        cout  << i << "," << bt->test(i) << " ";
         if(i%10 == 0){
             cout << endl;
         }
@@ -204,12 +955,12 @@ void BloomFilter::print(){
 //Calculates the size of the bloom filter using the expected false positive probability,
 //expected number of element entries, and a scalar multiplier.
 //This is accomplished using the equation given in the instructions.
-int BloomFilter::BloomFilterSize(double p, int m, float c){
+unsigned long long BloomFilter::BloomFilterSize(double p, int m, float c){
     //log(p) = ln p
     double temp = (double(m) * log(p));
     temp = -1*temp;
     double ln = log(2) * log(2);
-    int ans = temp/ln;
+    unsigned long long ans = temp/ln;
     ans = ans * c;
 
     return ans;
@@ -218,378 +969,551 @@ int BloomFilter::BloomFilterSize(double p, int m, float c){
 //hash function for the bloom filter
 //The index paramter picks which hash function, from the hash function
 // family, will be used on the element paramter.
-//Hash function equation = (((ax + b) mod k) mod m)
-//a and b are random numbers from 1 to k-1
-//x is the element parameter
-//k is the highest prime number after the bloom filter size
+//Hash function equation = ((h1 + index * h2) * m) >> 64
+//h1 is the element parameter (the 64 bit hash of the string)
+//h2 is h1 with its 32 bit halves swapped, made odd
 //m is the bloom filter size
-int BloomFilter::hash(unsigned int element, int index){
-    //getting the a and b value for the hash function.
-    unsigned long long a = hFunc[index].first;
-    unsigned long long b = hFunc[index].second;
-    unsigned int maxInt = UINT_MAX;
-    a = a * element;
-    //modding a by the max int value to make sure it will not cause overflow problems.
-    a = a % maxInt;
-    unsigned long long c = a + b;
-    bool notPrime = true;
-    c = c % k;
-    c = c % size;
-    int ans = c % INT_MAX;
+unsigned long long BloomFilter::hash(uint64_t element, int index){
+    return classicProbe(element, index, size);
+}
 
-    return ans;
+//makes a random seed from the system's random device
+uint64_t randomSeed(){
+    random_device rd;
+    return ((uint64_t)rd() << 32) ^ (uint64_t)rd();
+}
+
+//hashes a string into 64 bits using the seed of this filter.
+uint64_t BloomFilter::keyHash(string_view element){
+    return hashKey(element.data(), element.size(), seed);
+}
+
+//finds the block an element belongs to in the blocked layout.
+//The first hash function picks the block, so every other probe of the element
+//stays in the same 64 byte cache line. Classic layout has no blocks so the base is 0.
+unsigned long long BloomFilter::blockBase(uint64_t element){
+    if(layout == BLOOM_CLASSIC){
+        return 0;
+    }
+    return reduceRange(element, size / BLOCK_BITS) * BLOCK_BITS;
+}
+
+//gets the bit index for the index'th hash function of element.
+//In the classic layout this is just the hash. In the blocked layout the top 9 bits
+//of g_i pick a bit inside the element's block. The high bits of the hash already
+//picked the block, so the hash is multiplied by an odd constant first to spread the
+//low bits upward; otherwise the first probe would depend on the block.
+unsigned long long BloomFilter::probe(uint64_t element, int index, unsigned long long base){
+    if(layout == BLOOM_CLASSIC){
+        return hash(element,index);
+    }
+    return blockedProbe(element, index, base);
 }
 
 //Calculating the number of hash functions required for the bloom filter based on the 
 //bloom filter size, number of elements, and a scalar.
-//This is done using the in class equation.
+//This is done using the in class equation, k = (n / m) ln 2, scaled by d.
+//k is rounded to the nearest whole number only after scaling. It used to be cut down to a whole
+//number first and then again after scaling, so 6.9 became 6 and with d = 0.15 the 6.6 of a
+//p = 0.01 filter became 0, a filter which says yes to everything.
 //log(x) = ln x
-int BloomFilter::numHashFunctions(int n, int m, float d){
+int BloomFilter::numHashFunctions(unsigned long long n, int m, float d){
     double temp = double(n)/m;
-    int ans = ((temp * log(2)));
-    if(ans == 0){
+    int ans = (int) lround(temp * log(2) * d);
+    if(ans < 1){
         ans = 1;
     }
-    ans = ans * d;
     return ans;
 }
 
-//converts a string into an unsigned int
-//Uses the formula given in the instructions:
-//x = d[0] * C^0 + d[1]*C^1 + d[n]*C^n
-//d = to the string argument
-//C is a constant. In this case it is 53 because that is a prime number close to the number of
-//letters(upper and lower).
-unsigned int strToInt(string element){
-    //made as long long to help avoid overflow
-    unsigned long long  sum= 0;
-    unsigned long long c = 1;
-    //The constant
-    int mult = 53;
-    unsigned int ans = 0;
-    //iterates through each character in element and adds the value to the sum.
-    for(int i = 0; i < element.size(); i++){
-        sum += (c * element[i])%UINT_MAX;
-        //setting the constant to C^i. Would have been C^i-1 before this.
-        //Starts at C^0
-        c = c * mult;
-        //modding C down to 32 bits to avoid any overflow.
-        c = c % UINT_MAX;
-    }
-    //Modding the total sum down to 32 bits to match the return type of the function.
-    ans = sum % UINT_MAX;
-    return ans;
+//How many different bits blockedProbe sets for a key with k hash functions, as a distribution:
+//spread[d] is the fraction of keys which set d different bits, and spread[0] the mean.
+//The probes step through the block by h2's top 9 bits plus a fraction from the bits below, so
+//a key whose step is close to 0, 256, 512/3... sets only a few different bits and one that
+//lands on those few set bits is a false positive. That happens to about 1 in 100 keys, which
+//barely matters at a rate of 0.01 but is most of the rate below 0.001. The distribution is
+//worked out over 16 steps between each pair of whole steps.
+static void blockedSpread(unsigned int k, double* spread){
+    const int parts = 16;
+    for(unsigned int d = 0; d <= k; d++){
+        spread[d] = 0;
+    }
+    for(int s = 0; s < BLOCK_BITS * parts; s++){
+        double step = (s + 0.5) / parts;
+        uint64_t seen[BLOCK_BITS / 64] = {0};
+        unsigned int distinct = 0;
+        for(unsigned int i = 0; i < k; i++){
+            unsigned int bit = (unsigned int) fmod(floor(0.5 + i * step), BLOCK_BITS);
+            if(!((seen[bit / 64] >> (bit % 64)) & 1)){
+                seen[bit / 64] |= uint64_t(1) << (bit % 64);
+                distinct++;
+            }
+        }
+        spread[distinct] += 1.0 / (BLOCK_BITS * parts);
+        spread[0] += double(distinct) / (BLOCK_BITS * parts);
+    }
 }
 
+//Expected false positive rate of a filter of size bits with k hash functions once n elements
+//are in it.
+//Classic: (1 - e^(-kn/size))^k.
+//Blocked: the number of elements in a block is roughly Poisson with mean 512n/size, and a block
+//with j elements acts like a classic filter of 512 bits with j elements, so the rate is the
+//classic rate of a block averaged over the Poisson distribution. The classic rate of a block is
+//then corrected for keys whose probes set fewer than k different bits (see blockedSpread),
+//which takes the rate of k = 7 at 16 bits per element from 0.0010 to 0.0013 (0.0014 measured).
+double BloomFilter::expectedFpr(BloomLayout layout, unsigned long long size, unsigned int k, double n){
+    double m = double(size);
+    double hashes = k;
+    if(layout == BLOOM_CLASSIC){
+        return pow(1 - exp(-hashes * n / m), hashes);
+    }
+    //the spreads for up to 32 hash functions are worked out once; the tuner asks for them a lot
+    const unsigned int tableK = 32;
+    static const vector<vector<double>> table = [](){
+        vector<vector<double>> t(tableK + 1);
+        for(unsigned int j = 1; j <= tableK; j++){
+            t[j].resize(j + 1);
+            blockedSpread(j, t[j].data());
+        }
+        return t;
+    }();
+    vector<double> spread(k + 1);
+    if(k <= tableK){
+        spread = table[k];
+    }else{
+        blockedSpread(k, spread.data());
+    }
+    double mean = BLOCK_BITS * n / m;
+    double total = 0;
+    //the Poisson probabilities are worked out in logs so a big mean doesn't underflow e^-mean
+    int first = max(0, (int) (mean - 20 * sqrt(mean) - 20));
+    double logProb = -mean + first * log(max(mean, 1e-300)) - lgamma(first + 1.0);
+    for(int j = first; j < mean + 20 * sqrt(mean) + 20; j++){
+        double fill = 1 - pow(1 - 1.0 / BLOCK_BITS, spread[0] * j);
+        double rate = 0;
+        for(unsigned int d = 1; d <= k; d++){
+            rate += spread[d] * pow(fill, d);
+        }
+        total += exp(logProb) * rate;
+        logProb += log(max(mean, 1e-300)) - log(j + 1.0);
+    }
+    return total;
+}
+
+//64 bit key hash, modeled after wyhash.
+//Reads the key 8 bytes at a time (4 or fewer for short keys) and mixes with 64x64->128 bit
+//multiplies, folding the high half back into the low half.
+static inline uint64_t wymix(uint64_t a, uint64_t b){
+    unsigned __int128 r = (unsigned __int128)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t read8(const uint8_t* p){
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t read4(const uint8_t* p){
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+uint64_t hashKey(const void* key, size_t len, uint64_t seed){
+    //the mixing constants from wyhash
+    const uint64_t s0 = 0xa0761d6478bd642full;
+    const uint64_t s1 = 0xe7037ed1a0b428dbull;
+    const uint64_t s2 = 0x8ebc6af09c88c6e3ull;
+    const uint64_t s3 = 0x589965cc75374cc3ull;
+    const uint8_t* p = (const uint8_t*) key;
+    uint64_t a = 0;
+    uint64_t b = 0;
+    seed ^= wymix(seed ^ s0, s1);
+    if(len <= 16){
+        if(len >= 4){
+            //two overlapping reads from each end cover every byte
+            size_t mid = (len >> 3) << 2;
+            a = (read4(p) << 32) | read4(p + mid);
+            b = (read4(p + len - 4) << 32) | read4(p + len - 4 - mid);
+        }else if(len > 0){
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+        }
+    }else{
+        size_t i = len;
+        if(i > 48){
+            //three independent lanes for long keys
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do{
+                seed = wymix(read8(p) ^ s1, read8(p + 8) ^ seed);
+                seed1 = wymix(read8(p + 16) ^ s2, read8(p + 24) ^ seed1);
+                seed2 = wymix(read8(p + 32) ^ s3, read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            }while(i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while(i > 16){
+            seed = wymix(read8(p) ^ s1, read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+    a ^= s1;
+    b ^= seed;
+    unsigned __int128 r = (unsigned __int128)a * b;
+    return wymix((uint64_t)r ^ s0 ^ len, (uint64_t)(r >> 64) ^ s1);
+}
+
+//Arrays of at least this many bytes are mapped straight from the kernel instead of allocated.
+//2 MB is the size of a huge page on x86-64.
+const size_t HUGE_PAGE = 2 << 20;
+
+//Bit array constructor.
+//n is the number of bits. The words are aligned to 64 bytes so that a block in the
+//blocked layout lines up with a cache line, and every bit starts as 0.
+//Small arrays are allocated and zeroed. Large ones are an anonymous mapping, which the kernel
+//hands out already zeroed one page at a time on first touch, so making a filter of many GB
+//doesn't have to write to all of it first. The mapping is aligned to a huge page and asked
+//to use huge pages, which cuts the TLB misses of the random probes.
+BitArray::BitArray(unsigned long long n){
+    nbits = n;
+    nwords = (n + 63) / 64;
+    //aligned_alloc needs the size to be a multiple of the alignment
+    unsigned long long bytes = ((nwords * 8 + 63) / 64) * 64;
+    if(bytes == 0){
+        bytes = 64;
+    }
+    mapping = NULL;
+    mappingLen = 0;
+    dirty = NULL;
+    npages = 0;
+    if(bytes >= HUGE_PAGE){
+        size_t len = ((bytes + HUGE_PAGE - 1) / HUGE_PAGE) * HUGE_PAGE;
+        //maps an extra huge page so the start can be moved up to a huge page boundary
+        void* raw = mmap(NULL, len + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(raw != MAP_FAILED){
+            char* start = (char*) (((uintptr_t) raw + HUGE_PAGE - 1) & ~(uintptr_t) (HUGE_PAGE - 1));
+            size_t head = start - (char*) raw;
+            if(head > 0){
+                munmap(raw, head);
+            }
+            munmap(start + len, HUGE_PAGE - head);
+#ifdef MADV_HUGEPAGE
+            madvise(start, len, MADV_HUGEPAGE);
+#endif
+            mapping = start;
+            mappingLen = len;
+            words = (uint64_t*) start;
+            return;
+        }
+    }
+    words = (uint64_t*) aligned_alloc(64, bytes);
+    memset(words, 0, bytes);
+}
+
+//Bit array constructor for bits in a memory mapped file.
+//The words start offset bytes into the mapping, which has to keep them 64 byte aligned.
+BitArray::BitArray(unsigned long long n, void* mapping, size_t mappingLen, size_t offset){
+    nbits = n;
+    nwords = (n + 63) / 64;
+    words = (uint64_t*) ((char*) mapping + offset);
+    this->mapping = mapping;
+    this->mappingLen = mappingLen;
+    dirty = NULL;
+    npages = 0;
+}
+
+//bit array destructor.
+BitArray::~BitArray(){
+    if(mapping != NULL){
+        munmap(mapping, mappingLen);
+    }else{
+        free(words);
+    }
+    delete[] dirty;
+}
+
+//sets every bit in the array back to 0
+void BitArray::clear(){
+    memset(words, 0, nwords * 8);
+    markAllDirty();
+}
+
+//turns dirty page tracking on or off.
+//Not safe while other threads set bits.
+void BitArray::trackDirty(bool on){
+    delete[] dirty;
+    dirty = NULL;
+    npages = 0;
+    if(on){
+        npages = (nwords * 8 + DIRTY_PAGE - 1) / DIRTY_PAGE;
+        dirty = new uint8_t[max(npages, 1ull)]();
+    }
+}
+
+void BitArray::markAllDirty(){
+    if(dirty != NULL){
+        for(unsigned long long p = 0; p < npages; p++){
+            __atomic_store_n(&dirty[p], 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+//takes the dirty pages.
+//The map is read 8 pages at a time and only pages found dirty are cleared, with an atomic
+//exchange: if it reads a 1 written by setAtomic, the bit that thread set is visible to
+//whoever copies the page next. A page a thread marks after the exchange stays dirty.
+void BitArray::takeDirty(vector<uint64_t>& pages){
+    if(dirty == NULL){
+        return;
+    }
+    unsigned long long p = 0;
+    for(; p + 8 <= npages; p += 8){
+        uint64_t eight;
+        memcpy(&eight, dirty + p, 8);
+        if(eight == 0){
+            continue;
+        }
+        for(int j = 0; j < 8; j++){
+            if(__atomic_load_n(&dirty[p + j], __ATOMIC_RELAXED) && __atomic_exchange_n(&dirty[p + j], 0, __ATOMIC_ACQUIRE)){
+                pages.push_back(p + j);
+            }
+        }
+    }
+    for(; p < npages; p++){
+        if(__atomic_load_n(&dirty[p], __ATOMIC_RELAXED) && __atomic_exchange_n(&dirty[p], 0, __ATOMIC_ACQUIRE)){
+            pages.push_back(p);
+        }
+    }
+}
+
+size_t BitArray::pageBytes(uint64_t page){
+    return min(DIRTY_PAGE, (size_t) (nwords * 8 - page * DIRTY_PAGE));
+}
+
+//counts the bits set to 1 in n words.
+//Without -mpopcnt the compiler turns __builtin_popcountll into a slow library call, so
+//there is a copy compiled for the popcnt instruction which is used when the cpu has it.
+static unsigned long long popcountScalar(const uint64_t* words, unsigned long long n){
+    unsigned long long count = 0;
+    for(unsigned long long i = 0; i < n; i++){
+        count += __builtin_popcountll(words[i]);
+    }
+    return count;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt")))
+static unsigned long long popcountInstr(const uint64_t* words, unsigned long long n){
+    unsigned long long count = 0;
+    for(unsigned long long i = 0; i < n; i++){
+        count += __builtin_popcountll(words[i]);
+    }
+    return count;
+}
+#endif
+
+//counts the bits set to 1 in n words with the fastest version the cpu has.
+unsigned long long popcountWords(const uint64_t* words, unsigned long long n){
+#if defined(__x86_64__)
+    static bool hasPopcnt = __builtin_cpu_supports("popcnt");
+    if(hasPopcnt){
+        return popcountInstr(words, n);
+    }
+#endif
+    return popcountScalar(words, n);
+}
+
+//counts how many bits are set to 1 in the array.
+//Uses the popcount instruction on each 64 bit word instead of checking bits one at a time.
+unsigned long long BitArray::popcount(){
+    return popcountWords(words, nwords);
+}
+
+
+//Control bytes for the hash table.
+//A full slot has the low 7 bits of its key's hash, which is never negative.
+const int8_t EMPTY = -128;
+const int8_t DELETED = -2;
+const int GROUP = 16; //control bytes compared at once
+
+//Returns a mask with bit i set if control byte i of the group equals b.
+static inline unsigned int matchGroup(const int8_t* group, int8_t b){
+#if defined(__x86_64__)
+    __m128i bytes = _mm_load_si128((const __m128i*) group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(b)));
+#else
+    unsigned int mask = 0;
+    for(int i = 0; i < GROUP; i++){
+        mask |= (unsigned int)(group[i] == b) << i;
+    }
+    return mask;
+#endif
+}
 
 //Hash table constructor.
-//input is the hash table size.
+//input is the number of elements expected. The size is the next power of two with room
+//for them below the 7/8 load limit.
 HashTable::HashTable(int q){
-    m = q;
-    hashTable = new node*[q];
-    for(int i = 0; i < m; i++){
-        hashTable[i] = NULL;
+    m = GROUP;
+    while((long long)m * 7 / 8 < q){
+        m *= 2;
     }
-    
+    count = 0;
+    deleted = 0;
+    garbage = 0;
+    changes = 0;
+    ctrl = (int8_t*) aligned_alloc(GROUP, m);
+    memset(ctrl, EMPTY, m);
+    slots = new Slot[m];
 }
 
 
 //Hashing function for the hash table.
-//function is: x mod m
-//x is the int corresponding to the inputed string
-// m is the size of the hash table
-int HashTable::hash(string element){
-    unsigned int num = strToInt(element); 
-    return (num % m);
+//Uses the same 64 bit hash as the bloom filter with a fixed seed.
+//The low 7 bits go in the control byte and the rest pick the first group to look in.
+uint64_t HashTable::hash(string_view element){
+    return hashKey(element.data(), element.size(), 0x2545f4914f6cdd1dull);
+}
+
+//finds the slot holding element.
+//Starts at the group picked by the hash and moves forward a growing number of groups
+//each time (1, 2, 3, ...), which visits every group because m is a power of two.
+//Stops at the first group with an EMPTY slot since element would have been put there.
+//returns -1 if element is not in the table.
+long long HashTable::findSlot(uint64_t h, string_view element){
+    int8_t tag = h & 0x7f;
+    long long group = (h >> 7) & (m - 1) & ~(long long)(GROUP - 1);
+    for(long long step = GROUP; ; step += GROUP){
+        unsigned int match = matchGroup(ctrl + group, tag);
+        while(match){
+            long long i = group + __builtin_ctz(match);
+            if(slots[i].hash == h && slots[i].len == element.size() &&
+               memcmp(arena.data() + slots[i].offset, element.data(), element.size()) == 0){
+                return i;
+            }
+            match &= match - 1;
+        }
+        if(matchGroup(ctrl + group, EMPTY)){
+            return -1;
+        }
+        group = (group + step) & (m - 1);
+    }
 }
 
-//inserts an element into a bucket in the hash table.
-//Adds element to the front of that buckets linked list.
-void HashTable::insert(string element){
+//inserts an element into the hash table.
+//The key bytes are added to the end of the arena and the first EMPTY or DELETED
+//slot along the element's probe sequence points to them.
+void HashTable::insert(string_view element){
+    uint64_t h = hash(element);
     //Will not insert into the hash table if the element already exists in it.
-    if(!find(element)){
-        int index = hash(element);
-        node* in = new node();
-        in->val = element;
-        node* temp = hashTable[index];
-        hashTable[index] = in;
-        in->next = temp;
-    }
-}
-
-//goes through the hash table bucket assoicated with element
-//If element is in the bucket it will remove it from that bucket.
-//If it is not there nothing will happen.
-void HashTable::remove(string element){
-    int index = hash(element);
-    node* temp = hashTable[index];
-    if(temp == NULL){
+    if(findSlot(h, element) >= 0){
         return;
     }
-    if(temp->val == element){
-       hashTable[index] = temp->next;
-       delete temp;
-       return;
-    }
-    node* prev = temp;
-    temp = temp->next;
-    while(temp != NULL){
-        if(temp->val == element){
-            prev->next = temp->next;
-            delete temp;
+    if((long long)(count + deleted + 1) > (long long)m * 7 / 8){
+        //doubles the table, unless most of the used slots are deleted ones
+        grow(count >= m / 4 ? m * 2 : m);
+    }else if(garbage > 4096 && garbage > arena.size() / 2){
+        //inserts can keep reusing DELETED slots, so the arena is also compacted
+        //once most of it belongs to removed keys
+        grow(m);
+    }
+    long long group = (h >> 7) & (m - 1) & ~(long long)(GROUP - 1);
+    for(long long step = GROUP; ; step += GROUP){
+        unsigned int avail = matchGroup(ctrl + group, EMPTY) | matchGroup(ctrl + group, DELETED);
+        if(avail){
+            long long i = group + __builtin_ctz(avail);
+            if(ctrl[i] == DELETED){
+                deleted--;
+            }
+            ctrl[i] = h & 0x7f;
+            slots[i].hash = h;
+            slots[i].offset = arena.size();
+            slots[i].len = element.size();
+            arena.insert(arena.end(), element.begin(), element.end());
+            count++;
+            changes++;
             return;
         }
-        prev = temp;
-        temp = temp->next;
+        group = (group + step) & (m - 1);
     }
-    return;
 }
 
-//goes through the hash table bucket assoicated with element
-//If element is in the bucket it will return true, otherwise it returns false
-bool HashTable::find(string element){
-    int index = hash(element);
-    node* temp = hashTable[index];
-    while(temp != NULL){
-        if(temp->val == element){
-            return true;
+//Moves every element into a new table of size newSize.
+//Only the keys still in the table are copied into the new arena, so this also frees
+//the bytes of removed keys.
+void HashTable::grow(int newSize){
+    int8_t* oldCtrl = ctrl;
+    Slot* oldSlots = slots;
+    int oldSize = m;
+    vector<char> oldArena;
+    oldArena.swap(arena);
+    m = newSize;
+    count = 0;
+    deleted = 0;
+    garbage = 0;
+    ctrl = (int8_t*) aligned_alloc(GROUP, m);
+    memset(ctrl, EMPTY, m);
+    slots = new Slot[m];
+    for(int i = 0; i < oldSize; i++){
+        if(oldCtrl[i] >= 0){
+            insert(string_view(oldArena.data() + oldSlots[i].offset, oldSlots[i].len));
         }
-        temp = temp->next;
     }
-    return false;
+    free(oldCtrl);
+    delete[] oldSlots;
+}
+
+//If element is in the hash table its slot is marked DELETED.
+//The slot can't be made EMPTY because that would stop lookups of elements further along
+//the same probe sequence. If it is not there nothing will happen.
+void HashTable::remove(string_view element){
+    long long i = findSlot(hash(element), element);
+    if(i < 0){
+        return;
+    }
+    ctrl[i] = DELETED;
+    count--;
+    deleted++;
+    garbage += slots[i].len;
+    changes++;
+}
+
+//If element is in the hash table it will return true, otherwise it returns false
+bool HashTable::find(string_view element){
+    return findSlot(hash(element), element) >= 0;
+}
+
+//copies out every key in the table.
+//Copies so the table can be changed while going through them.
+vector<string> HashTable::keys(){
+    vector<string> out;
+    for(int i = 0; i < m; i++){
+        if(ctrl[i] >= 0){
+            out.push_back(string(arena.data() + slots[i].offset, slots[i].len));
+        }
+    }
+    return out;
 }
 
 //outputs the hash table for testing purposes.
 void HashTable::print(){
     for(int i = 0; i< m; i++){
-        if(hashTable[i] == NULL){
+        if(ctrl[i] < 0){
             cout << 0 << " " << endl;
         }else{
-              node* temp = hashTable[i];
-             while(temp != NULL){
-                cout << temp->val << " -> ";
-                temp = temp->next;
-             }
-             cout << endl;
-         }
+            cout << string(arena.data() + slots[i].offset, slots[i].len) << endl;
+        }
     }
 }
 
-//Goes through each hashtable linked list and deletes it.
-//Then deletes the array holding the linked lists.
+//Deletes the control bytes and slots. The arena frees itself.
 HashTable::~HashTable(){
-    node* temp;
-    node* del;
-     for(int i =0; i < m; i++){
-        temp = hashTable[i];
-        del = temp;
-        while(temp != NULL){
-            temp = temp->next;
-            delete del;
-            del = temp;
-        }
-     }
-     delete[] hashTable;
-}
-
-
-
-int main(int argc, char* argv[]){
-
-
-    vector<string> a;
-    string temp;
-    ifstream f;
-    double p;
-    int m;
-    float c;
-    float d;
-    
-    //Parsing setup.txt
-    f.open(argv[1]);
-    if(f.is_open()){
-        while(getline(f,temp)){
-            a.push_back(temp);
-        }
-        p = stod(a[0]);
-        m = stoi(a[1]);
-        c = stof(a[2]);
-        d = stof(a[3]);
-      //  cout << p;
-        f.close();
-    }
-    BloomFilter b = BloomFilter(p,m,c,d);
-    cout << "Experiment for values of: " << endl;
-    cout << "p = " << p << endl;
-    cout << "c = " <<  c <<endl;
-    cout << "d = " << d << endl;
-    cout << "q = " << b.q << endl;
-    // cout << b.size << endl;
-    //  cout << b.hFunc.size() << endl;
-    ifstream fa;
-    fa.open(argv[4]);
-   // getline(fa,temp);
-    ifstream in;
-    in.open(argv[2]);
-   // getline(in,temp);
-    ifstream s;
-    s.open(argv[3]);
-  //  getline(s,temp);
-    ifstream r;
-    r.open(argv[5]);
-   // getline(r,temp);
-    double countF = 0;
-    double countN = 0;
-    double countFTotal = 0;
-    double countNTotal = 0;
-    vector<string> falseNeg;
-    vector<string> falseNegTotal;
-    for(int i =0; i < 10; i++){
-        countN = 0;
-        countF = 0;
-        falseNeg.clear();
-        //Parsing input.txt
-        if(in.is_open()){
-            for(int i = 0; i < 1000; i++){
-                getline(in,temp);
-                b.insert(temp);
-            }
-        }
-        //parsing successfulSearch.txt
-        if(s.is_open()){
-            for(int i = 0; i < 100; i++){
-                getline(s,temp);
-                bool x = b.find(temp);
-            //   cout << x;
-               if(x == false){
-                    countN++;
-                    countNTotal++;
-                }
-            }
-        }
-
-        
-        //parsing failedSearch.txt
-        if(fa.is_open()){
-            for(int i = 0; i < 100; i++){
-                getline(fa,temp);
-                bool x = b.find(temp);
-                //cout  <<  x;
-                if(x == true){
-                    countF++;
-                    countFTotal++;
-                    falseNeg.push_back(temp);
-                    falseNegTotal.push_back(temp);
-                }
-            }
-        }
-        
-        //parsing remove.txt
-        if(r.is_open()){
-            for(int i = 0; i < 100; i++){
-                getline(r,temp);
-                b.remove(temp);
-            }
-            
-        }
-        cout << "Phase " << i+1 << endl;
-        cout << "Number of false negatives: " << endl;
-        cout << countN << endl;
-        cout << "Number of false positives: " << endl;
-        cout << countF << endl;
-        cout << "Probability of false positives: " << endl;
-        cout << countF/100 << endl;
-        cout << "False Positive Elements: " << endl;
-        for(int i = 0; i < countF; i++){
-            cout << falseNeg[i] << " " << i+1 << endl;
-        }
-    }
-    f.close();
-    r.close();
-    s.close();
-    fa.close();
-    //b.print();
-
-    cout << "Number of false negatives: " << endl;
-    cout << countNTotal << endl;
-    cout << "Number of false positives: " << endl;
-    cout << countFTotal << endl;
-    cout << "Probability of false positives: " << endl;
-    cout << countFTotal/1000 << endl;
-
-
-
-
-    //BloomFilter b = BloomFilter(0.1, 10, 1.0, 1.0);
-    // HashTable* h = new HashTable(2);
-    //  h->insert("asd");
-    // h->insert("asdsd");
-    // h->insert("adfsd");
-    // h->insert("adfsd");
-    // h->insert("adfsd");
-    // h->insert("asdfd");
-    // h->print();
-    // delete h;
-    // b.insert("asd");
-    // cout << b.find("asd") << endl;
-    // b.insert("sdk");
-    // b.insert("owjkdo");
-    // b.remove("asd");
-    // cout << b.find("asd") << endl;
-    // b.remove("sdk");
-    // b.remove("asd");
-    // b.remove("owjkdo");
-    // b.print();
-    // cout << endl;
-    // b.ht->print();
-    // int si = b.ht->m;
-    // b.ht->print();
-    // for(int i = 0; i < si; i++){
-    //     if(b.ht->hashTable[i] != NULL){
-    //         cout << i << endl;
-    //     }
-    // }
-     //delete b.ht;
-    // for(int i = 0; i < si; i++){
-    //     if(b.ht == NULL){
-    //         cout << "sjd" << endl;
-    //     }
-    //     if(b.ht->hashTable[i] != NULL){
-    //         cout << i << endl;
-    //     }
-    // }
-
-
-
-
-
-
-    // b.insert("asdfg");
-    // cout << b.find("asdfg") << endl;
-    // b.remove("asdfg");
-    // cout << b.find("asdfg") << endl;
-    // cout << b.ht->find("asdfg") << endl;
-    // b.insert("asdfg");
-    // cout << b.find("asdfg") << endl;
-    // cout << b.ht->find("asdfg") << endl;
-
-
-    //b.print();
-    
-
-
-
-
-
-    // HashTable h = HashTable(2);
-    // h.insert("2");
-    // h.insert("5");
-    // h.insert("a");
-    // h.insert("3");
-    // h.insert("4");
-    // h.insert("2");
-    // cout << h.find("2") << endl;
-    // h.remove("4");
-    // cout << h.find("2") << endl;
-    return 0;
+    free(ctrl);
+    delete[] slots;
 }
@@ -1,30 +1,222 @@
 #ifndef BLOOM_H
 #define BLOOM_H
 
-using namespace std;
-//Nodes for singly linked list in auxilary hash table
-struct node {
-    string val;
-    struct node* next;
-  };
-
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
+using namespace std;
+//One slot of the auxilary hash table.
+//The key bytes live in the table's arena, the slot only keeps where they are.
+struct Slot {
+    uint64_t hash; //full 64 bit hash of the key, compared before the key bytes
+    uint64_t offset; //where the key starts in the arena
+    uint32_t len; //length of the key
+};
 
 //Class for auxilary hash table
-//table uses separate chaining and has linked lists in each bucket
+//table uses open addressing with one control byte per slot (like Google's SwissTable).
+//The control byte is EMPTY, DELETED, or 7 bits of the key's hash, and a lookup compares
+//a group of 16 control bytes at a time so it rarely has to look at a slot that doesn't match.
+//The table doubles in size when it gets 7/8 full.
 class HashTable {
   public:
-    HashTable(int q);  //constructor
+    HashTable(int q);  //constructor, q is the number of elements expected
     ~HashTable();      //destructor
-    void insert (string element);  //insert into hash table
-    void remove (string element); //remove value from hash table
-    bool find (string element); //find in hash table
-    int hash(string element); //makes an index to a bucket in the hash table from a given string 
-    int m; //size of the hash table
-    node** hashTable; // array of node pointers for the hashtable and linked lists.
+    void insert (string_view element);  //insert into hash table
+    void remove (string_view element); //remove value from hash table
+    bool find (string_view element); //find in hash table
+    uint64_t hash(string_view element); //makes the 64 bit hash the table uses for a given string
+    int m; //size of the hash table, a power of two and at least 16
+    int count; //number of elements in the hash table
+    int deleted; //number of slots marked DELETED
+    int8_t* ctrl; //control byte of each slot
+    Slot* slots; //slots of the hash table
+    vector<char> arena; //bytes of every key in the table, one after another
+    vector<string> keys(); //copies of every key in the table
+    uint64_t garbage; //bytes in the arena which belong to removed keys
+    uint64_t changes; //number of inserts and removes which changed the table, so checkpoints can tell
     void print(); //printing method for testing
   private: 
-    
+    long long findSlot(uint64_t h, string_view element); //slot holding element or -1
+    void grow(int newSize); //moves everything into a table of size newSize
+};
+
+//Bytes of bit array in one page of the dirty page map (see BitArray::trackDirty).
+const size_t DIRTY_PAGE = 4096;
+const int DIRTY_SHIFT = 15; //log2 of the bits in a page
+
+//Packed bit array used as the storage for the bloom filter.
+//Bits are kept 64 to a word, so a filter of n bits takes n/8 bytes instead of n bytes.
+class BitArray {
+  public:
+    BitArray(unsigned long long n); //constructor, n = number of bits. Every bit starts as 0
+    //constructor for bits which live in a memory mapped file.
+    //mapping is the start of the mapping, mappingLen its length, and the bits start offset bytes in.
+    //The mapping is unmapped by the destructor.
+    BitArray(unsigned long long n, void* mapping, size_t mappingLen, size_t offset);
+    ~BitArray();                    //destructor
+    void set(unsigned long long i);  //sets bit i to 1
+    bool test(unsigned long long i); //returns true if bit i is 1
+    //Versions of set and test which are safe to call from many threads at once.
+    //setAtomic does an atomic or on the bit's word, testAtomic a relaxed atomic load.
+    void setAtomic(unsigned long long i);
+    bool testAtomic(unsigned long long i);
+    void clear(); //sets every bit back to 0
+    unsigned long long popcount(); //counts the number of bits which are 1
+    //Dirty page tracking, for incremental checkpoints (see checkpoint.h).
+    //While it is on, set and setAtomic mark the 4 KB page of every bit they set in dirty, one
+    //byte per page, and anything else which changes the words (clear, union and intersection)
+    //marks every page. Off it costs set one predictable branch.
+    void trackDirty(bool on); //turns tracking on with every page clean, or off
+    void markAllDirty(); //marks every page, if tracking is on
+    //Adds the index of every dirty page to pages and marks them clean. Safe while other threads
+    //use setAtomic: a page set during or after the call is dirty again for the next one.
+    void takeDirty(vector<uint64_t>& pages);
+    size_t pageBytes(uint64_t page); //bytes of the bit array in page (the last one can be short)
+    uint8_t* dirty; //dirty page map, 1 for a page changed since it was last taken, NULL if off
+    unsigned long long npages; //number of pages in the dirty page map
+    unsigned long long nbits; //number of bits in the array
+    unsigned long long nwords; //number of 64 bit words backing the array
+    uint64_t* words; //the packed bits, aligned to 64 bytes. bit i is bit (i%64) of words[i/64]
+    void* mapping; //memory mapping holding words (a file, or anonymous for large arrays), NULL if words was allocated
+    size_t mappingLen; //length of the mapping
+};
+
+//counts the bits set to 1 in n words, with the popcount instruction if the cpu has it
+unsigned long long popcountWords(const uint64_t* words, unsigned long long n);
+
+//set and test are on the hot path of insert and find so they are defined here to be inlined.
+inline void BitArray::set(unsigned long long i){
+    words[i >> 6] |= (uint64_t(1) << (i & 63));
+    if(dirty != NULL){
+        dirty[i >> DIRTY_SHIFT] = 1;
+    }
+}
+
+inline bool BitArray::test(unsigned long long i){
+    return (words[i >> 6] >> (i & 63)) & 1;
+}
+
+inline void BitArray::setAtomic(unsigned long long i){
+    __atomic_fetch_or(&words[i >> 6], uint64_t(1) << (i & 63), __ATOMIC_RELAXED);
+    //release, so a checkpoint which sees the page dirty also sees the bit
+    if(dirty != NULL){
+        __atomic_store_n(&dirty[i >> DIRTY_SHIFT], 1, __ATOMIC_RELEASE);
+    }
+}
+
+inline bool BitArray::testAtomic(unsigned long long i){
+    return (__atomic_load_n(&words[i >> 6], __ATOMIC_RELAXED) >> (i & 63)) & 1;
+}
+
+//64 bit hash of a key, modeled after wyhash.
+//Every key is hashed once with this and the bloom filter derives all of its
+//probe indices from the result (see BloomFilter::hash).
+//seed picks a different function from the family.
+uint64_t hashKey(const void* key, size_t len, uint64_t seed);
+
+//Seed filters use when they aren't given one. A fixed default means building the same
+//keys with the same parameters gives the same bits every run, so filters can be merged
+//and shared between processes. Pass randomSeed() for a filter whose hash can't be guessed.
+const uint64_t DEFAULT_SEED = 0x5bd1e9955bd1e995ull;
+
+//Makes a random seed.
+uint64_t randomSeed();
+
+//Maps a 64 bit hash onto [0, n) with a multiply and shift instead of a modulo.
+//The high bits of the hash decide the result.
+inline uint64_t reduceRange(uint64_t h, uint64_t n){
+    return (uint64_t)(((unsigned __int128)h * n) >> 64);
+}
+
+//Bit index of probe i of key hash h in a classic filter of size bits (see BloomFilter::hash).
+inline uint64_t classicProbe(uint64_t h, unsigned int i, uint64_t size){
+    uint64_t h2 = ((h >> 32) | (h << 32)) | 1;
+    return reduceRange(h + i * h2, size);
+}
+
+//Bit index of probe i of key hash h in the block starting at bit base (see BloomFilter::probe).
+inline uint64_t blockedProbe(uint64_t h, unsigned int i, uint64_t base){
+    uint64_t h1 = h * 0x9e3779b97f4a7c15ull;
+    uint64_t h2 = ((h1 >> 32) | (h1 << 32)) | 1;
+    return base + ((h1 + i * h2) >> 55);
+}
+
+//Layout of the bits in the bloom filter.
+//BLOOM_CLASSIC lets every hash function pick any bit in the whole array.
+//BLOOM_BLOCKED uses the first hash to pick one 512 bit (64 byte, one cache line) block and
+//puts every probe for the element inside that block, so a lookup touches a single cache line.
+//It needs a few more bits than classic for the same false positive rate.
+enum BloomLayout { BLOOM_CLASSIC, BLOOM_BLOCKED };
+
+const int BLOCK_BITS = 512; //bits in one block of the blocked layout
+
+//Most expected removes the remove hash table of a new filter starts with room for.
+const int REMOVE_TABLE_START = 1 << 16;
+
+//Header of a bloom filter file (see BloomFilter::save and BloomFilter::open).
+//The file is this header, zeros up to the 4096 byte mark, the bit array words, and
+//then the removed keys as a 32 bit length followed by the key bytes for each one.
+//The bit array starts on a page boundary so it can be memory mapped and used in place.
+//Everything is stored in the byte order of the machine which wrote it.
+const char BLOOM_MAGIC[8] = {'B','L','O','O','M','F','L','T'};
+const uint32_t BLOOM_VERSION = 1;
+const size_t BLOOM_DATA_OFFSET = 4096;
+
+struct BloomFileHeader {
+    char magic[8]; //BLOOM_MAGIC
+    uint32_t version; //BLOOM_VERSION
+    uint32_t layout; //BloomLayout of the filter
+    uint64_t size; //size of the bloom filter in bits
+    uint64_t numHash; //number of hash functions
+    uint64_t seed; //seed of the key hash
+    uint64_t numElem; //expected number of elements
+    uint64_t numRemoved; //number of removed keys stored after the bit array
+    uint64_t removedBytes; //bytes of the removed keys section
+    uint64_t bitsChecksum; //hashKey of the bit array words, seed 0
+    uint64_t headerChecksum; //hashKey of all the fields above, seed 0
+};
+//Statistics.
+//Every filter counts its inserts, lookups and removes unless the whole program is built with
+//-DBLOOM_STATS=0, which takes the counters out of the class and the hot paths entirely.
+//It has to be the same for every file of a program since it changes the class layout.
+#ifndef BLOOM_STATS
+#define BLOOM_STATS 1
+#endif
+
+//Operation counts of one thread (or of the whole filter outside concurrent mode).
+//Aligned to a cache line so threads counting in their own slot don't share lines.
+struct alignas(64) BloomCounters {
+    uint64_t inserts; //insert calls and keys given to insertMany or bulkLoad
+    uint64_t lookups; //find calls and keys given to findMany
+    uint64_t positives; //lookups which said the key is in the filter
+    uint64_t tombstoneHits; //lookups which found the key in the remove hash table
+    uint64_t removes; //remove calls
+};
+
+//Counter slots of a concurrent filter. Threads take slots in turn, so up to this many threads
+//never share one.
+const int STATS_SLOTS = 16;
+
+//Snapshot of a filter's statistics (see BloomFilter::stats).
+struct BloomStats {
+    uint64_t inserts; //insert calls and keys given to insertMany or bulkLoad
+    uint64_t lookups; //find calls and keys given to findMany
+    uint64_t positives; //lookups which said the key is in the filter
+    uint64_t negatives; //lookups which said it isn't
+    uint64_t tombstoneHits; //lookups which found the key in the remove hash table
+    uint64_t removes; //remove calls
+    uint64_t tombstones; //keys in the remove hash table now
+    unsigned long long size; //bits in the filter
+    unsigned int numHash; //number of hash functions
+    unsigned long long bitsSet; //bits which are 1
+    double fillRatio; //bitsSet / size
+    double estimatedCount; //estimated number of distinct elements inserted (see estimateCount)
+    double estimatedFpr; //chance a key which was never inserted is found, given the bits set now
 };
 
 class BloomFilter{
@@ -34,35 +226,177 @@ class BloomFilter{
     //m = expected number of elements which will be added to the bloom filter
     //c = scale factor of bloom filter size
     //d = scale factor of number of hash functions
-
-    BloomFilter(double p, int m, float c, float d); 
+    //layout = classic or cache line blocked bit layout
+    //concurrent = true if many threads will insert and find at the same time
+    //seed = seed of the key hash. Filters built with the same parameters and seed can be merged.
+
+    BloomFilter(double p, int m, float c, float d, BloomLayout layout = BLOOM_CLASSIC, bool concurrent = false,
+                uint64_t seed = DEFAULT_SEED); 
+    //constructor for a filter with an exact size and set of hash functions.
+    //size = size of the bloom filter in bits (rounded up to whole blocks for the blocked layout)
+    //numHash = number of hash functions
+    //seed = seed of the key hash. Filters with the same size, numHash, seed and layout hash alike.
+    //bits = bit array to use instead of allocating a new one, the filter deletes it (used by open)
+    BloomFilter(unsigned long long size, unsigned int numHash, uint64_t seed, BloomLayout layout = BLOOM_CLASSIC,
+                bool concurrent = false, BitArray* bits = NULL);
         ~BloomFilter(); //destructor for Bloom Filter
-        void insert(string element); //insert into the Bloom Filter
-        void remove(string element); //Remove from the Bloom Filter by adding to the Hash Table
-        bool find(string element); //Check if a string exists in the Bloom Filter
-        int BloomFilterSize(double p, int m, float c); //Calculates the size the Bloom Filter using the equation given in class
-        int numHashFunctions(int n, int m, float d); //Calculates the number of hash functions using the equation from class
-       //Converts a number into a index in the bloom filter
-       //element is an int which should be the int associated with a string which will be inputed into the bloom filter
+        //Keys are taken as string_views so they are never copied. The versions taking
+        //a pointer and a length are for keys which are raw bytes (e.g. in a network buffer).
+        void insert(string_view element); //insert into the Bloom Filter
+        void remove(string_view element); //Remove from the Bloom Filter by adding to the Hash Table
+        bool find(string_view element); //Check if a string exists in the Bloom Filter
+        void insert(const void* key, size_t len);
+        void remove(const void* key, size_t len);
+        bool find(const void* key, size_t len);
+        //insert and find for a key whose hash, keyHash(element), is already known.
+        //Used by filters made of many BloomFilters which hash each key once.
+        void insertHashed(string_view element, uint64_t elem);
+        bool findHashed(string_view element, uint64_t elem);
+        //Checks n keys at once. Bit i of found (found[i/64] >> (i%64)) is set to 1 if keys[i]
+        //is in the Bloom Filter and 0 if not. found needs (n+63)/64 words.
+        void findMany(const string_view* keys, size_t n, uint64_t* found);
+        void insertMany(const string_view* keys, size_t n); //inserts n keys at once
+        static unsigned long long BloomFilterSize(double p, int m, float c); //Calculates the size the Bloom Filter using the equation given in class
+        static int numHashFunctions(unsigned long long n, int m, float d); //Calculates the number of hash functions using the equation from class
+        //Expected false positive rate of a filter of size bits with k hash functions holding n elements.
+        static double expectedFpr(BloomLayout layout, unsigned long long size, unsigned int k, double n);
+       //Converts a key hash into a index in the bloom filter
+       //element is the 64 bit hash of a string which will be inputed into the bloom filter (from keyHash)
        //index is an int which represents which hash function will be chosen from a family of functions to use on element.
-        int hash(unsigned int element, int index); 
+        unsigned long long hash(uint64_t element, int index); 
+        uint64_t keyHash(string_view element); //hashes a string with the filter's seed
+        //Returns the first bit of the block the element is in for the blocked layout, 0 for classic.
+        unsigned long long blockBase(uint64_t element);
+        //Returns the bit index for the index'th hash function of element, base is the result of blockBase.
+        unsigned long long probe(uint64_t element, int index, unsigned long long base);
+        bool isRemoved(string_view element); //checks the remove hash table, skipping it when it is empty
+        void clearRemoved(string_view element); //takes element out of the remove hash table if it is there
         void print();  //Print out bloom filter for testing purposes
+        //Probe loops of insert and find.
+        //testBits checks and setBits sets the bits of a key hash. K is the number of hash functions,
+        //known at compile time so the loop is fully unrolled, or 0 to loop numHash times.
+        //L is the layout and C is true for concurrent mode.
+        //pickProbeLoops points testFn and setFn at the versions for this filter, for k up to 16.
+        template <unsigned int K, int L, bool C> bool testBits(uint64_t element);
+        template <unsigned int K, int L, bool C> void setBits(uint64_t element);
+        void pickProbeLoops();
+        bool (BloomFilter::*testFn)(uint64_t element);
+        void (BloomFilter::*setFn)(uint64_t element);
+        //Writes the filter to path in the bloom filter file format. Returns false if it couldn't.
+        bool save(const char* path);
+        //The removed keys packed the way the file format stores them. In concurrent mode the
+        //caller holds htLock.
+        string removedSection();
+        //Replaces the removed keys with the ones in a section made by removedSection.
+        void loadRemoved(const char* section, size_t bytes);
+        //Opens a filter written by save by memory mapping it, so only the pages lookups touch are read
+        //and processes opening the same file share them through the page cache.
+        //The mapping is private: inserts into the opened filter work but never change the file.
+        //verify = also check the bit array checksum, which reads the whole file.
+        //Returns NULL if the file is missing or isn't a valid filter.
+        static BloomFilter* open(const char* path, bool verify = false);
+        //Merging filters.
+        //Two filters can only be merged if they have the same size, hash functions, seed and layout.
+        //Neither filter may be in use by other threads while merging.
+        bool compatible(BloomFilter& other); //true if other can be merged with this filter
+        //Makes this filter hold every element of this filter or other. Returns false (and does
+        //nothing) if they aren't compatible.
+        bool unionWith(BloomFilter& other);
+        //Union with count filters at once. The bit array is merged a cache sized piece at a time,
+        //so each word of this filter is read and written once no matter how many filters there are.
+        bool unionWith(BloomFilter** others, size_t count);
+        //Makes this filter hold the elements in both this filter and other. A key in only one of them
+        //can still be a false positive of the result, at about the rate of the bigger of the two.
+        bool intersectWith(BloomFilter& other);
+        //Estimates the number of distinct elements in the filter from how many bits are set
+        //(Swamidass and Baldi): n = -(size / k) * ln(1 - set bits / size).
+        double estimateCount();
+        //Statistics.
+        //stats counts the bits set (one pass over the bit array) and adds up the operation counts
+        //of every thread. It can run while other threads use a concurrent filter; the counts
+        //are then only as of about the time of the call.
+        BloomStats stats();
+        void resetStats(); //sets the operation counts back to 0
+        //add to the operation counts. Used by insert, find and the like, and by bulk loaders
+        //which set bits themselves.
+        void countInserts(uint64_t n);
+        void countLookups(uint64_t n, uint64_t positives, uint64_t tombstoneHits);
+        void countRemoves(uint64_t n);
 
         //Data
         unsigned int numElem; //expected number of elements added into the bloom filter
-        unsigned int size; //size of the bloom filter
-        unsigned long long k; //First prime number greater than size. Used in the hashing function
+        unsigned long long size; //size of the bloom filter in bits
+        BloomLayout layout; //which bit layout the filter uses
         unsigned int pr; //expected probability of false positive
         int q; //size of the remove hash table
-        vector<pair<unsigned int, unsigned int> > hFunc; //vector carrying pairs of random ints used for the family of hashing functions
-        bool* bt; //array of booleans for the bloom filter
+        unsigned int numHash; //number of hash functions
+        uint64_t seed; //seed which picks the key hash function out of the family
+        BitArray* bt; //packed bit array for the bloom filter
         HashTable* ht; //remove hash table
+        //Concurrent mode.
+        //Bits are set with atomic or and read with relaxed atomic loads, so inserts never
+        //wait and lookups never block on the bit array. The remove hash table is only
+        //touched under htLock, and numRemoved lets threads skip it while it is empty.
+        bool concurrent;
+        mutex htLock;
+        atomic<int> numRemoved;
+#if BLOOM_STATS
+        //operation counts, STATS_SLOTS of them in concurrent mode and 1 otherwise
+        BloomCounters* counters;
+        BloomCounters& statsSlot(); //the calling thread's slot
+#endif
+    private:
+        bool contains(string_view element); //find without counting, used by insert and remove
 
 
 };
 
+//Counting is on the hot path so these are defined here to be inlined.
+#if BLOOM_STATS
+//Each thread takes the next slot the first time it counts anything.
+inline BloomCounters& BloomFilter::statsSlot(){
+    if(!concurrent){
+        return counters[0];
+    }
+    static atomic<unsigned int> nextSlot(0);
+    thread_local unsigned int slot = nextSlot.fetch_add(1, memory_order_relaxed) % STATS_SLOTS;
+    return counters[slot];
+}
+
+//Adds n to a counter. Slots can be shared by threads in concurrent mode, so the add is
+//atomic then; it is relaxed since nothing is ordered by it.
+inline void countAdd(uint64_t& counter, uint64_t n, bool atomic){
+    if(atomic){
+        __atomic_fetch_add(&counter, n, __ATOMIC_RELAXED);
+    }else{
+        counter += n;
+    }
+}
+#endif
+
+inline void BloomFilter::countInserts(uint64_t n){
+#if BLOOM_STATS
+    countAdd(statsSlot().inserts, n, concurrent);
+#endif
+}
+
+inline void BloomFilter::countLookups(uint64_t n, uint64_t positives, uint64_t tombstoneHits){
+#if BLOOM_STATS
+    BloomCounters& c = statsSlot();
+    countAdd(c.lookups, n, concurrent);
+    countAdd(c.positives, positives, concurrent);
+    if(tombstoneHits > 0){
+        countAdd(c.tombstoneHits, tombstoneHits, concurrent);
+    }
+#endif
+}
+
+inline void BloomFilter::countRemoves(uint64_t n){
+#if BLOOM_STATS
+    countAdd(statsSlot().removes, n, concurrent);
+#endif
+}
 
-unsigned int strToInt(string element);
 
 
 
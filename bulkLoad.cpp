@@ -0,0 +1,158 @@
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bulkLoad.h"
+
+using namespace std;
+
+//Keys hashed ahead of setting their bits, the same batch size as BloomFilter::insertMany.
+const size_t BULK_BATCH = 64;
+
+//Sets the bits of every line in [start, end) in bits.
+//atomic = set with atomic or because other threads share bits.
+//Returns the number of lines.
+static unsigned long long loadChunk(BloomFilter& b, BitArray* bits, const char* start, const char* end, bool atomic){
+    vector<uint64_t> probes(BULK_BATCH * b.numHash);
+    unsigned long long lines = 0;
+    const char* p = start;
+    while(p < end){
+        //hashing a batch of lines and prefetching their words
+        size_t count = 0;
+        while(count < BULK_BATCH && p < end){
+            const char* newline = (const char*) memchr(p, '\n', end - p);
+            const char* lineEnd = newline != NULL ? newline : end;
+            uint64_t elem = b.keyHash(string_view(p, lineEnd - p));
+            unsigned long long base = b.blockBase(elem);
+            for(unsigned int i = 0; i < b.numHash; i++){
+                probes[b.numHash * count + i] = b.probe(elem,i,base);
+                __builtin_prefetch(bits->words + (probes[b.numHash * count + i] >> 6), 1);
+            }
+            count++;
+            p = lineEnd + 1;
+        }
+        for(size_t i = 0; i < count * b.numHash; i++){
+            if(atomic){
+                bits->setAtomic(probes[i]);
+            }else{
+                bits->set(probes[i]);
+            }
+        }
+        lines += count;
+    }
+    return lines;
+}
+
+//Bulk load of a file of keys.
+BulkLoadResult bulkLoad(BloomFilter& b, const char* path, int threads, BulkStrategy strategy){
+    BulkLoadResult result;
+    result.ok = false;
+    result.keys = 0;
+    result.seconds = 0;
+    auto startTime = chrono::steady_clock::now();
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return result;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        close(fd);
+        return result;
+    }
+    size_t len = st.st_size;
+    if(len == 0){
+        close(fd);
+        result.ok = true;
+        return result;
+    }
+    const char* data = (const char*) mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+        return result;
+    }
+    madvise((void*) data, len, MADV_SEQUENTIAL);
+    if(threads <= 0){
+        threads = max((int) thread::hardware_concurrency(), 1);
+    }
+
+    //splitting the file into one chunk per thread. Each chunk boundary is moved forward
+    //to just after a newline so no line is split between two threads.
+    vector<const char*> bounds(threads + 1);
+    bounds[0] = data;
+    bounds[threads] = data + len;
+    for(int t = 1; t < threads; t++){
+        const char* p = data + len / threads * t;
+        if(p < bounds[t - 1]){
+            p = bounds[t - 1];
+        }
+        const char* newline = (const char*) memchr(p, '\n', data + len - p);
+        bounds[t] = newline != NULL ? newline + 1 : data + len;
+    }
+
+    vector<unsigned long long> lines(threads, 0);
+    vector<BitArray*> copies(threads, NULL);
+    vector<thread> workers;
+    for(int t = 0; t < threads; t++){
+        workers.push_back(thread([&, t](){
+            if(strategy == BULK_MERGE){
+                copies[t] = new BitArray(b.size);
+                lines[t] = loadChunk(b, copies[t], bounds[t], bounds[t + 1], false);
+            }else{
+                lines[t] = loadChunk(b, b.bt, bounds[t], bounds[t + 1], true);
+            }
+        }));
+    }
+    for(thread& w : workers){
+        w.join();
+    }
+    workers.clear();
+    if(strategy == BULK_MERGE){
+        //every thread ORs its share of the words from all of the copies into the filter
+        for(int t = 0; t < threads; t++){
+            workers.push_back(thread([&, t](){
+                unsigned long long from = b.bt->nwords * t / threads;
+                unsigned long long to = b.bt->nwords * (t + 1) / threads;
+                for(int c = 0; c < threads; c++){
+                    uint64_t* src = copies[c]->words;
+                    for(unsigned long long w = from; w < to; w++){
+                        b.bt->words[w] |= src[w];
+                    }
+                }
+            }));
+        }
+        for(thread& w : workers){
+            w.join();
+        }
+        //the words were written directly, not through set, so no page was marked dirty.
+        //A merge touches every word, so all of the pages are.
+        b.bt->markAllDirty();
+        for(BitArray* copy : copies){
+            delete copy;
+        }
+    }
+
+    //insert takes keys back out of the remove hash table. That table isn't thread safe, and it is
+    //empty for almost every bulk load, so when it isn't the lines are gone through once more here.
+    if(b.ht->count > 0){
+        const char* p = data;
+        const char* end = data + len;
+        while(p < end){
+            const char* newline = (const char*) memchr(p, '\n', end - p);
+            const char* lineEnd = newline != NULL ? newline : end;
+            b.clearRemoved(string_view(p, lineEnd - p));
+            p = lineEnd + 1;
+        }
+    }
+    munmap((void*) data, len);
+    for(unsigned long long n : lines){
+        result.keys += n;
+    }
+    b.countInserts(result.keys);
+    result.ok = true;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    return result;
+}
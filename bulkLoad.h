@@ -0,0 +1,29 @@
+#ifndef BULK_H
+#define BULK_H
+
+#include "bloomFilter.h"
+
+//How bulkLoad sets bits from many threads.
+//BULK_ATOMIC: every thread sets bits in the filter itself with atomic or. Uses no extra memory
+//and is the better choice for big filters, where two threads rarely touch the same cache line.
+//BULK_MERGE: every thread fills its own copy of the bit array without atomics, and the copies
+//are OR-ed into the filter at the end (also split across the threads). Costs a copy of the bit
+//array per thread, but avoids contention on small filters where every thread hits the same lines.
+enum BulkStrategy { BULK_ATOMIC, BULK_MERGE };
+
+//Result of a bulk load.
+struct BulkLoadResult {
+    bool ok; //false if the file couldn't be opened or mapped
+    unsigned long long keys; //number of keys (lines) inserted
+    double seconds; //time the load took
+};
+
+//Inserts every line of the file at path into b, the same as calling b.insert on each line
+//read with getline, using many threads.
+//The file is memory mapped and split into one chunk per thread at line boundaries; each thread
+//hashes its lines in batches and prefetches their bits before setting them.
+//threads = number of threads, 0 for one per core
+//Nothing else may use b while it is loading.
+BulkLoadResult bulkLoad(BloomFilter& b, const char* path, int threads = 0, BulkStrategy strategy = BULK_ATOMIC);
+
+#endif
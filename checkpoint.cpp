@@ -0,0 +1,374 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "checkpoint.h"
+
+using namespace std;
+
+//Pages copied out and written at a time (1 MB).
+const size_t CHECKPOINT_CHUNK = 256;
+
+//writes all n bytes at offset of fd
+static bool writeAt(int fd, const void* p, size_t n, off_t offset){
+    const char* c = (const char*) p;
+    while(n > 0){
+        ssize_t w = pwrite(fd, c, n, offset);
+        if(w < 0 && errno == EINTR){
+            continue;
+        }
+        if(w <= 0){
+            return false;
+        }
+        c += w;
+        n -= w;
+        offset += w;
+    }
+    return true;
+}
+
+//fsyncs the directory holding path, so a file renamed into it stays renamed after a power failure
+static bool syncDir(const string& path){
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0){
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+//fsyncs a file by its path
+static bool syncFile(const string& path){
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+//headerChecksum of the filter file at path, 0 if it can't be read
+static uint64_t snapshotChecksum(const string& path){
+    BloomFileHeader header;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return 0;
+    }
+    bool ok = pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header);
+    close(fd);
+    return ok ? header.headerChecksum : 0;
+}
+
+FilterCheckpointer::FilterCheckpointer(BloomFilter* b, const char* path, bool durable, double compactAt){
+    filter = b;
+    this->path = path;
+    logPath = this->path + ".log";
+    logFd = -1;
+    this->durable = durable;
+    this->compactAt = compactAt;
+    sequence = 0;
+    logBytes = 0;
+    removedChanges = 0;
+    lastPages = 0;
+    lastBytes = 0;
+    lastCompacted = false;
+    checkpoints = 0;
+    compactions = 0;
+    replayed = 0;
+}
+
+FilterCheckpointer::~FilterCheckpointer(){
+    if(logFd >= 0){
+        close(logFd);
+    }
+    delete filter;
+}
+
+FilterCheckpointer* FilterCheckpointer::create(BloomFilter* b, const char* path, bool durable, double compactAt){
+    FilterCheckpointer* c = new FilterCheckpointer(b, path, durable, compactAt);
+    b->bt->trackDirty(true);
+    if(!c->compact()){
+        //b stays the caller's
+        b->bt->trackDirty(false);
+        c->filter = NULL;
+        delete c;
+        return NULL;
+    }
+    return c;
+}
+
+FilterCheckpointer* FilterCheckpointer::recover(const char* path, bool durable, double compactAt){
+    BloomFilter* b = BloomFilter::open(path, true);
+    if(b == NULL){
+        return NULL;
+    }
+    FilterCheckpointer* c = new FilterCheckpointer(b, path, durable, compactAt);
+    b->bt->trackDirty(true);
+    if(!c->replay(snapshotChecksum(c->path))){
+        delete c;
+        return NULL;
+    }
+    c->removedChanges = b->ht->changes;
+    return c;
+}
+
+bool FilterCheckpointer::compact(){
+    //everything from here on is either in the snapshot or dirty again for the next checkpoint
+    pages.clear();
+    filter->bt->takeDirty(pages);
+    uint64_t changes;
+    if(filter->concurrent){
+        lock_guard<mutex> guard(filter->htLock);
+        changes = filter->ht->changes;
+    }else{
+        changes = filter->ht->changes;
+    }
+    //written next to the old snapshot and renamed over it, so a crash leaves one or the other
+    string tmp = path + ".tmp";
+    bool ok = filter->save(tmp.c_str()) && (!durable || syncFile(tmp)) && rename(tmp.c_str(), path.c_str()) == 0 &&
+              (!durable || syncDir(path));
+    if(!ok){
+        unlink(tmp.c_str());
+        filter->bt->markAllDirty();
+        return false;
+    }
+    //until the new log replaces the old one, the old one doesn't match the new snapshot and
+    //recovery leaves it out
+    if(!startLog(snapshotChecksum(path))){
+        filter->bt->markAllDirty();
+        return false;
+    }
+    removedChanges = changes;
+    lastPages = filter->bt->npages;
+    lastBytes = BLOOM_DATA_OFFSET + filter->bt->nwords * 8;
+    lastCompacted = true;
+    compactions++;
+    return true;
+}
+
+bool FilterCheckpointer::startLog(uint64_t snapshotChecksum){
+    CheckpointLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+    header.version = CHECKPOINT_VERSION;
+    header.pageBytes = DIRTY_PAGE;
+    header.snapshotChecksum = snapshotChecksum;
+    header.headerChecksum = hashKey(&header, offsetof(CheckpointLogHeader, headerChecksum), 0);
+    string tmp = logPath + ".tmp";
+    int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(fd < 0){
+        return false;
+    }
+    if(!writeAt(fd, &header, sizeof(header), 0) || (durable && fsync(fd) != 0) ||
+       rename(tmp.c_str(), logPath.c_str()) != 0 || (durable && !syncDir(logPath))){
+        close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+    if(logFd >= 0){
+        close(logFd);
+    }
+    logFd = fd;
+    logBytes = sizeof(header);
+    sequence = 0;
+    return true;
+}
+
+bool FilterCheckpointer::replay(uint64_t snapshotChecksum){
+    int fd = open(logPath.c_str(), O_RDWR | O_CLOEXEC);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CheckpointLogHeader)){
+        //no log (or not even a whole header of one), so nothing was checkpointed after the snapshot
+        if(fd >= 0){
+            close(fd);
+        }
+        return startLog(snapshotChecksum);
+    }
+    size_t size = st.st_size;
+    const char* log = (const char*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(log == MAP_FAILED){
+        close(fd);
+        return false;
+    }
+    CheckpointLogHeader header;
+    memcpy(&header, log, sizeof(header));
+    if(memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0 || header.version != CHECKPOINT_VERSION ||
+       header.pageBytes != DIRTY_PAGE || header.headerChecksum != hashKey(&header, offsetof(CheckpointLogHeader, headerChecksum), 0) ||
+       header.snapshotChecksum != snapshotChecksum){
+        //a log from before the last compaction, which the snapshot already has
+        munmap((void*) log, size);
+        close(fd);
+        return startLog(snapshotChecksum);
+    }
+    BitArray* bits = filter->bt;
+    size_t pos = sizeof(header);
+    while(size - pos >= sizeof(CheckpointRecord)){
+        CheckpointRecord rec;
+        memcpy(&rec, log + pos, sizeof(rec));
+        if(rec.headerChecksum != hashKey(&rec, offsetof(CheckpointRecord, headerChecksum), 0) ||
+           rec.sequence != sequence + 1 || rec.numPages > bits->npages){
+            break;
+        }
+        //works out the length of the record and checks every page index before using any
+        const char* p = log + pos + sizeof(rec);
+        size_t left = size - pos - sizeof(rec);
+        if(left < rec.numPages * 8){
+            break;
+        }
+        const char* indices = p;
+        size_t dataBytes = rec.numPages * 8;
+        bool valid = true;
+        for(uint64_t j = 0; j < rec.numPages && valid; j++){
+            uint64_t page;
+            memcpy(&page, indices + 8 * j, 8);
+            valid = page < bits->npages;
+            if(valid){
+                dataBytes += bits->pageBytes(page);
+            }
+        }
+        uint64_t removedBytes = rec.removedBytes == CHECKPOINT_SAME_REMOVED ? 0 : rec.removedBytes;
+        if(!valid || dataBytes > left || removedBytes > left - dataBytes){
+            break;
+        }
+        uint64_t sum = hashKey(indices, rec.numPages * 8, 0);
+        const char* data = indices + rec.numPages * 8;
+        for(uint64_t j = 0; j < rec.numPages; j++){
+            uint64_t page;
+            memcpy(&page, indices + 8 * j, 8);
+            size_t n = bits->pageBytes(page);
+            sum = hashKey(data, n, sum);
+            data += n;
+        }
+        if(rec.removedBytes != CHECKPOINT_SAME_REMOVED){
+            sum = hashKey(data, removedBytes, sum);
+        }
+        if(sum != rec.dataChecksum){
+            break;
+        }
+        //the record is whole, so it's applied
+        data = indices + rec.numPages * 8;
+        for(uint64_t j = 0; j < rec.numPages; j++){
+            uint64_t page;
+            memcpy(&page, indices + 8 * j, 8);
+            size_t n = bits->pageBytes(page);
+            memcpy((char*) bits->words + page * DIRTY_PAGE, data, n);
+            data += n;
+        }
+        if(rec.removedBytes != CHECKPOINT_SAME_REMOVED){
+            filter->loadRemoved(data, removedBytes);
+        }
+        pos += sizeof(rec) + dataBytes + removedBytes;
+        sequence++;
+        replayed++;
+    }
+    munmap((void*) log, size);
+    //cuts off a torn record, so new records don't end up after it where they'd never be replayed
+    if(pos < size && (ftruncate(fd, pos) != 0 || (durable && fsync(fd) != 0))){
+        close(fd);
+        return false;
+    }
+    logFd = fd;
+    logBytes = pos;
+    return true;
+}
+
+bool FilterCheckpointer::checkpoint(){
+    if(logFd < 0){
+        return false;
+    }
+    BitArray* bits = filter->bt;
+    pages.clear();
+    bits->takeDirty(pages);
+    string removed;
+    bool removedChanged = false;
+    uint64_t changes;
+    if(filter->concurrent){
+        lock_guard<mutex> guard(filter->htLock);
+        changes = filter->ht->changes;
+        if(changes != removedChanges){
+            removed = filter->removedSection();
+            removedChanged = true;
+        }
+    }else{
+        changes = filter->ht->changes;
+        if(changes != removedChanges){
+            removed = filter->removedSection();
+            removedChanged = true;
+        }
+    }
+    lastCompacted = false;
+    if(pages.empty() && !removedChanged){
+        lastPages = 0;
+        lastBytes = 0;
+        return true;
+    }
+    //pages come out in order, so the page bytes add up without looking at each one
+    size_t pageData = pages.size() * DIRTY_PAGE;
+    if(!pages.empty() && pages.back() == bits->npages - 1){
+        pageData -= DIRTY_PAGE - bits->pageBytes(pages.back());
+    }
+    size_t recordBytes = sizeof(CheckpointRecord) + pages.size() * 8 + pageData + removed.size();
+    if(logBytes + recordBytes > compactAt * bits->nwords * 8){
+        //compact takes the dirty pages over again, and the snapshot has all of them
+        return compact();
+    }
+    off_t start = logBytes;
+    off_t offset = start + sizeof(CheckpointRecord);
+    bool ok = writeAt(logFd, pages.data(), pages.size() * 8, offset);
+    uint64_t sum = hashKey(pages.data(), pages.size() * 8, 0);
+    offset += pages.size() * 8;
+    buffer.resize(CHECKPOINT_CHUNK * DIRTY_PAGE);
+    for(size_t j = 0; j < pages.size() && ok; j += CHECKPOINT_CHUNK){
+        //copied out first, so the checksum is of exactly the bytes written even if other
+        //threads keep setting bits
+        size_t used = 0;
+        for(size_t i = j; i < min(j + CHECKPOINT_CHUNK, pages.size()); i++){
+            size_t n = bits->pageBytes(pages[i]);
+            memcpy(buffer.data() + used, (const char*) bits->words + pages[i] * DIRTY_PAGE, n);
+            sum = hashKey(buffer.data() + used, n, sum);
+            used += n;
+        }
+        ok = writeAt(logFd, buffer.data(), used, offset);
+        offset += used;
+    }
+    CheckpointRecord rec;
+    rec.sequence = sequence + 1;
+    rec.numPages = pages.size();
+    rec.removedBytes = CHECKPOINT_SAME_REMOVED;
+    if(removedChanged){
+        rec.removedBytes = removed.size();
+        sum = hashKey(removed.data(), removed.size(), sum);
+        ok = ok && writeAt(logFd, removed.data(), removed.size(), offset);
+        offset += removed.size();
+    }
+    rec.dataChecksum = sum;
+    rec.headerChecksum = hashKey(&rec, offsetof(CheckpointRecord, headerChecksum), 0);
+    //the header goes last: a record whose header made it to disk but whose pages didn't
+    //fails its data checksum
+    ok = ok && writeAt(logFd, &rec, sizeof(rec), start) && (!durable || fdatasync(logFd) == 0);
+    if(!ok){
+        //leaves the log as it was and the pages dirty, so the next checkpoint tries them again
+        if(ftruncate(logFd, start) != 0){
+            //the partial record fails its checksum and recovery cuts it off
+        }
+        for(uint64_t page : pages){
+            __atomic_store_n(&bits->dirty[page], 1, __ATOMIC_RELEASE);
+        }
+        return false;
+    }
+    logBytes = offset;
+    sequence++;
+    removedChanges = changes;
+    lastPages = pages.size();
+    lastBytes = recordBytes;
+    checkpoints++;
+    return true;
+}
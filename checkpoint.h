@@ -0,0 +1,98 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <vector>
+#include <string>
+#include "bloomFilter.h"
+
+//Incremental checkpoints of a filter which keeps changing.
+//Saving the whole bit array after every batch of inserts costs the size of the filter each
+//time, however few bits changed. Instead the bit array tracks which 4 KB pages were changed
+//(BitArray::trackDirty) and a checkpoint appends only those pages to a log next to a full
+//snapshot, so its cost follows how much changed, not how big the filter is.
+//Once the log has grown to compactAt times the size of the bit array, replaying it would take
+//longer than reading a snapshot, so the next checkpoint writes a new snapshot and starts an
+//empty log instead (compaction).
+//Recovery opens the snapshot and replays the log's records over it in order. Each record has
+//a checksum, so a record cut short by a crash is found and dropped along with anything after
+//it, and the filter comes back as of the last whole checkpoint.
+//Files: the snapshot is a normal filter file at path (BloomFilter::open reads it, without the
+//changes in the log), and the log is path + ".log".
+
+const char CHECKPOINT_MAGIC[8] = {'B','L','O','O','M','L','O','G'};
+const uint32_t CHECKPOINT_VERSION = 1;
+
+//Header at the start of the log.
+struct CheckpointLogHeader {
+    char magic[8]; //CHECKPOINT_MAGIC
+    uint32_t version; //CHECKPOINT_VERSION
+    uint32_t pageBytes; //DIRTY_PAGE
+    //headerChecksum of the snapshot the log goes with. A log left over from before a
+    //compaction doesn't match the new snapshot, so it is never replayed over it.
+    uint64_t snapshotChecksum;
+    uint64_t headerChecksum; //hashKey of the fields above, seed 0
+};
+
+//removedBytes of a record when the removed keys didn't change since the last record
+const uint64_t CHECKPOINT_SAME_REMOVED = ~uint64_t(0);
+
+//Header of one record of the log. It is followed by numPages uint64_t page indices, then the
+//pages (DIRTY_PAGE bytes each, less for the last page of the bit array), then the removed keys
+//section if removedBytes isn't CHECKPOINT_SAME_REMOVED.
+struct CheckpointRecord {
+    uint64_t sequence; //number of the checkpoint, counting from 1 after each snapshot
+    uint64_t numPages; //pages in the record
+    uint64_t removedBytes; //bytes of the removed keys section, or CHECKPOINT_SAME_REMOVED
+    uint64_t dataChecksum; //hashKey of the indices and then of each page and the removed keys, chained
+    uint64_t headerChecksum; //hashKey of the fields above, seed 0
+};
+
+class FilterCheckpointer {
+  public:
+    //Starts checkpointing b to path: writes a snapshot of it and an empty log, and turns on
+    //b's dirty page tracking. The checkpointer deletes b.
+    //durable = fsync every checkpoint and snapshot before returning, so they survive a power
+    //failure and not just a crash of the process
+    //compactAt = size of the log, in bit arrays, at which the next checkpoint compacts
+    //Returns NULL if the files couldn't be written.
+    static FilterCheckpointer* create(BloomFilter* b, const char* path, bool durable = true, double compactAt = 1);
+    //Recovers the filter checkpointed to path and keeps checkpointing it there. A record cut
+    //short at the end of the log is cut off the file.
+    //Returns NULL if the snapshot is missing or isn't a valid filter.
+    static FilterCheckpointer* recover(const char* path, bool durable = true, double compactAt = 1);
+    ~FilterCheckpointer(); //destructor, closes the log and deletes the filter
+    //Writes every change since the last checkpoint, appending the dirty pages to the log, or
+    //compacting if the log has grown too big. In concurrent mode other threads may insert
+    //while it runs; what they change during it goes into the next checkpoint.
+    //Returns false if the log couldn't be written.
+    bool checkpoint();
+    //Writes a new snapshot of the whole filter and starts an empty log.
+    bool compact();
+
+    //Data
+    BloomFilter* filter; //the filter being checkpointed
+    string path; //path of the snapshot
+    string logPath; //path of the log
+    int logFd; //log file, open for appending
+    bool durable; //fsync what is written
+    double compactAt; //compact once the log is this many times the bit array
+    uint64_t sequence; //number of the last record in the log
+    unsigned long long logBytes; //size of the log
+    uint64_t removedChanges; //filter->ht->changes as of the last checkpoint
+    //What the last checkpoint did, and totals
+    unsigned long long lastPages; //pages it wrote (every page for a compaction)
+    unsigned long long lastBytes; //bytes it wrote
+    bool lastCompacted; //true if it compacted
+    unsigned long long checkpoints; //checkpoints appended to a log
+    unsigned long long compactions; //snapshots written, the first one included
+    unsigned long long replayed; //records replayed by recover
+
+  private:
+    FilterCheckpointer(BloomFilter* b, const char* path, bool durable, double compactAt);
+    bool startLog(uint64_t snapshotChecksum); //replaces the log with an empty one for a snapshot
+    bool replay(uint64_t snapshotChecksum); //replays the log over the filter, cutting off a torn end
+    vector<uint64_t> pages; //dirty pages of a checkpoint, kept to not allocate each time
+    vector<char> buffer; //pages copied out for writing
+};
+
+#endif
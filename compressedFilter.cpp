@@ -0,0 +1,460 @@
+#include <vector>
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+#include <endian.h>
+#include "compressedFilter.h"
+
+using namespace std;
+
+//Bytes of code written out or read in at a time.
+const size_t CODE_CHUNK = 1 << 16;
+
+//Calls f with the position of every 1 bit of words in order, or of every 0 bit if invert.
+//Bits past nbits in the last word are never passed.
+template <class F>
+static void forEachPosition(const uint64_t* words, unsigned long long nwords, unsigned long long nbits,
+                            bool invert, F f){
+    for(unsigned long long w = 0; w < nwords; w++){
+        uint64_t x = invert ? ~words[w] : words[w];
+        if(w == nwords - 1 && nbits % 64 != 0){
+            x &= (uint64_t(1) << (nbits % 64)) - 1;
+        }
+        while(x != 0){
+            f(w * 64 + __builtin_ctzll(x));
+            x &= x - 1;
+        }
+    }
+}
+
+//Makes the header say the bit array is sent as it is.
+static void setRaw(BloomFilter& b, PackedFilterHeader& header){
+    header.coding = PACKED_RAW;
+    header.numCodes = 0;
+    header.riceBits = 0;
+    header.codeBytes = b.bt->nwords * 8;
+}
+
+//Fills in the fields of the header which describe the code: which bits are coded, r, and how
+//many bytes of code that makes. The bit array is sent as it is unless the code is at least
+//1/32 smaller.
+//The best Golomb parameter for gaps with mean g is about g * ln 2 (Gallager and van Voorhis),
+//so r is picked from the 3 powers of two around that by adding up how long the code would be
+//with each.
+static void planCode(BloomFilter& b, PackedFilterHeader& header){
+    unsigned long long set = b.bt->popcount();
+    bool zeros = set > b.size / 2;
+    unsigned long long coded = zeros ? b.size - set : set;
+    header.coding = zeros ? PACKED_ZEROS : PACKED_ONES;
+    header.numCodes = coded;
+    header.riceBits = 0;
+    header.codeBytes = 0;
+    if(coded == 0){
+        return;
+    }
+    //no code is shorter than the entropy, so filters near half full skip the counting pass
+    double f = double(coded) / b.size;
+    if(-(f * log2(f) + (1 - f) * log2(1 - f)) * b.size >= (b.bt->nwords * 8 - b.bt->nwords / 4) * 8.0){
+        setRaw(b, header);
+        return;
+    }
+    double mean = double(b.size) / coded;
+    int r0 = (int) floor(log2(max(mean * log(2.0), 1.0)));
+    int first = min(max(r0 - 1, 0), 29);
+    unsigned long long quotients[3] = {0, 0, 0};
+    unsigned long long prev = ~0ull;
+    forEachPosition(b.bt->words, b.bt->nwords, b.size, zeros, [&](unsigned long long pos){
+        unsigned long long gap = pos - prev - 1;
+        quotients[0] += gap >> first;
+        quotients[1] += gap >> (first + 1);
+        quotients[2] += gap >> (first + 2);
+        prev = pos;
+    });
+    unsigned long long best = ~0ull;
+    for(int j = 0; j < 3; j++){
+        //every gap is its quotient in 0 bits, a 1 bit, and r bits
+        unsigned long long bits = quotients[j] + coded * (1 + first + j);
+        if(bits < best){
+            best = bits;
+            header.riceBits = first + j;
+        }
+    }
+    header.codeBytes = (best + 7) / 8;
+    if(header.codeBytes >= b.bt->nwords * 8 - b.bt->nwords / 4){
+        setRaw(b, header);
+    }
+}
+
+unsigned long long compressedSize(BloomFilter& b){
+    PackedFilterHeader header;
+    planCode(b, header);
+    string removed;
+    if(b.concurrent){
+        lock_guard<mutex> guard(b.htLock);
+        removed = b.removedSection();
+    }else{
+        removed = b.removedSection();
+    }
+    return sizeof(PackedFilterHeader) + header.codeBytes + removed.size();
+}
+
+//Moves the whole bytes of acc to the end of data. All 8 bytes of acc are stored and len only
+//moves past the whole ones, so there is no branch on how many bits acc has.
+static inline void flushBits(char* data, size_t& len, uint64_t& acc, int& fill){
+    uint64_t out = htole64(acc);
+    memcpy(data + len, &out, 8);
+    len += fill >> 3;
+    acc >>= fill & 56;
+    fill &= 7;
+}
+
+//Writes the Rice code of the gaps between the 1 bits of words (or the 0 bits if zeros) to out,
+//low bit first: gap >> r in unary, then the low r bits of gap.
+//The bits are gathered in acc and moved to a buffer after each part of a code, and the buffer
+//is written to out every CODE_CHUNK bytes. The state is kept in locals rather than in an
+//object: stores into a byte buffer can alias anything, so fields would be written back to
+//memory and read again for every code.
+static void writeCode(ostream& out, const uint64_t* words, unsigned long long nwords, unsigned long long nbits,
+                      bool zeros, int r){
+    //room past CODE_CHUNK for the 8 byte stores of one code
+    vector<char> buf(CODE_CHUNK + 16);
+    char* data = buf.data();
+    size_t len = 0;
+    uint64_t acc = 0;
+    int fill = 0;
+    uint64_t lowMask = (uint64_t(1) << r) - 1;
+    unsigned long long prev = ~0ull;
+    for(unsigned long long w = 0; w < nwords; w++){
+        uint64_t x = zeros ? ~words[w] : words[w];
+        if(w == nwords - 1 && nbits % 64 != 0){
+            x &= (uint64_t(1) << (nbits % 64)) - 1;
+        }
+        while(x != 0){
+            unsigned long long pos = w * 64 + __builtin_ctzll(x);
+            x &= x - 1;
+            uint64_t gap = pos - prev - 1;
+            prev = pos;
+            uint64_t q = gap >> r;
+            while(q >= 32){
+                fill += 32;
+                flushBits(data, len, acc, fill);
+                q -= 32;
+                if(len >= CODE_CHUNK){
+                    out.write(data, len);
+                    len = 0;
+                }
+            }
+            acc |= (uint64_t(1) << q) << fill;
+            fill += q + 1;
+            flushBits(data, len, acc, fill);
+            acc |= (gap & lowMask) << fill;
+            fill += r;
+            flushBits(data, len, acc, fill);
+            if(len >= CODE_CHUNK){
+                out.write(data, len);
+                len = 0;
+            }
+        }
+    }
+    //the bits left over, padding the last byte with 0s
+    if(fill > 0){
+        data[len++] = (char) acc;
+    }
+    out.write(data, len);
+}
+
+bool exportCompressed(BloomFilter& b, ostream& out){
+    string removed;
+    uint64_t numRemoved;
+    if(b.concurrent){
+        lock_guard<mutex> guard(b.htLock);
+        removed = b.removedSection();
+        numRemoved = b.ht->count;
+    }else{
+        removed = b.removedSection();
+        numRemoved = b.ht->count;
+    }
+    PackedFilterHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACKED_MAGIC, 8);
+    header.version = PACKED_VERSION;
+    header.layout = b.layout;
+    header.size = b.size;
+    header.numHash = b.numHash;
+    header.seed = b.seed;
+    header.numElem = b.numElem;
+    planCode(b, header);
+    header.numRemoved = numRemoved;
+    header.removedBytes = removed.size();
+    header.bitsChecksum = hashKey(b.bt->words, b.bt->nwords * 8, 0);
+    header.headerChecksum = hashKey(&header, offsetof(PackedFilterHeader, headerChecksum), 0);
+    out.write((const char*) &header, sizeof(header));
+    if(header.coding == PACKED_RAW){
+        out.write((const char*) b.bt->words, b.bt->nwords * 8);
+    }else{
+        writeCode(out, b.bt->words, b.bt->nwords, b.size, header.coding == PACKED_ZEROS, header.riceBits);
+    }
+    out.write(removed.data(), removed.size());
+    return !out.fail();
+}
+
+//Bytes of code read from a stream by readCode and not yet used.
+struct CodeInput {
+    istream* in; //stream the code comes from
+    vector<uint8_t> buf; //bytes read from in, with 8 bytes of room for 8 byte loads
+    size_t pos; //next byte of buf to use
+    size_t len; //bytes in buf
+    uint64_t left; //bytes of code not yet read from in
+};
+
+//Moves the bytes of buf not used yet to the front and reads the next piece of code after them.
+static bool loadCode(CodeInput& input){
+    size_t keep = input.len - input.pos;
+    memmove(input.buf.data(), input.buf.data() + input.pos, keep);
+    input.pos = 0;
+    input.len = keep;
+    size_t want = min((uint64_t) CODE_CHUNK, input.left);
+    if(want > 0){
+        input.in->read((char*) input.buf.data() + keep, want);
+        size_t got = input.in->gcount();
+        input.len += got;
+        input.left = got < want ? 0 : input.left - want;
+    }
+    return input.len > 0;
+}
+
+//Tops acc up to at least 49 bits, or as many as there are left. acc holds avail bits and the
+//bits above them are always 0.
+//While there are 8 bytes in buf this is one 8 byte load (Giesen's branchless refill), done
+//even when acc is nearly full and takes no bytes: a branch on how full acc is would be
+//mispredicted whenever the lengths of the codes change.
+static inline void refillCode(CodeInput& input, uint64_t& acc, int& avail){
+    if(input.pos + 8 <= input.len){
+        uint64_t w;
+        memcpy(&w, input.buf.data() + input.pos, 8);
+        acc |= le64toh(w) << avail;
+        input.pos += (63 - avail) >> 3;
+        avail |= 56;
+        acc &= (uint64_t(1) << avail) - 1;
+        return;
+    }
+    while(avail <= 48 && (input.pos < input.len || loadCode(input))){
+        acc |= uint64_t(input.buf[input.pos++]) << avail;
+        avail += 8;
+    }
+}
+
+//Reads one gap coded with r low bits into gap. Returns false if the code ran out.
+//A run of 0 bits is found with one count of trailing zeros of acc.
+static bool readGap(CodeInput& input, uint64_t& acc, int& avail, int r, uint64_t& gap){
+    uint64_t q = 0;
+    refillCode(input, acc, avail);
+    while(acc == 0){
+        if(avail == 0){
+            return false;
+        }
+        q += avail;
+        avail = 0;
+        refillCode(input, acc, avail);
+    }
+    int t = __builtin_ctzll(acc);
+    q += t;
+    acc >>= t + 1;
+    avail -= t + 1;
+    if(avail < r){
+        refillCode(input, acc, avail);
+        if(avail < r){
+            return false;
+        }
+    }
+    gap = (q << r) | (acc & ((uint64_t(1) << r) - 1));
+    acc >>= r;
+    avail -= r;
+    return true;
+}
+
+//Where readCode is: the bits taken from the buffer and not used yet, the position of the last
+//bit decoded, and the number of codes decoded.
+struct DecodeState {
+    uint64_t acc; //bits taken from the buffer and not used yet
+    int avail; //number of bits in acc
+    unsigned long long at; //position of the last bit set, ~0 before the first
+    uint64_t done; //codes decoded
+};
+
+//Kernels for decoding the codes in data[pos, len) while there are at least 16 bytes left.
+//No code can run past 16 bytes unless its run of 0 bits is longer than acc, so they decode
+//with plain 8 byte loads and no calls, which keeps all of their state in registers. They stop
+//at a run longer than acc, leaving it for readGap. Return false if a gap is past nbits.
+typedef bool (*DecodeKernel)(const uint8_t* data, size_t& pos, size_t len, int r, uint64_t numCodes, uint64_t* words,
+                             unsigned long long nbits, DecodeState& st);
+
+//The body of the kernels, built once for any cpu and once with BMI2.
+//Positions only go up, so each bit is or-ed straight into words; the store doesn't hold up
+//the next code, which only waits on acc.
+static inline bool decodeRun(const uint8_t* data, size_t& pos, size_t len, int r, uint64_t numCodes, uint64_t* words,
+                             unsigned long long nbits, DecodeState& st){
+    uint64_t acc = st.acc;
+    int avail = st.avail;
+    unsigned long long at = st.at;
+    uint64_t done = st.done;
+    size_t p = pos;
+    uint64_t lowMask = (uint64_t(1) << r) - 1;
+    bool ok = true;
+    for(; done < numCodes && p + 16 <= len; done++){
+        uint64_t w;
+        memcpy(&w, data + p, 8);
+        acc |= le64toh(w) << avail;
+        p += (63 - avail) >> 3;
+        avail |= 56;
+        acc &= (uint64_t(1) << avail) - 1;
+        if(acc == 0){
+            break;
+        }
+        int t = __builtin_ctzll(acc);
+        acc >>= t + 1;
+        avail -= t + 1;
+        if(avail < r){
+            memcpy(&w, data + p, 8);
+            acc |= le64toh(w) << avail;
+            p += (63 - avail) >> 3;
+            avail |= 56;
+            acc &= (uint64_t(1) << avail) - 1;
+        }
+        uint64_t gap = ((uint64_t) t << r) | (acc & lowMask);
+        acc >>= r;
+        avail -= r;
+        if(gap >= nbits - (at + 1)){
+            ok = false;
+            break;
+        }
+        at += gap + 1;
+        words[at >> 6] |= uint64_t(1) << (at & 63);
+    }
+    st.acc = acc;
+    st.avail = avail;
+    st.at = at;
+    st.done = done;
+    pos = p;
+    return ok;
+}
+
+static bool decodeScalar(const uint8_t* data, size_t& pos, size_t len, int r, uint64_t numCodes, uint64_t* words,
+                         unsigned long long nbits, DecodeState& st){
+    return decodeRun(data, pos, len, r, numCodes, words, nbits, st);
+}
+
+#if defined(__x86_64__)
+//shrx and shlx shift by a register without waiting on the flags like shr and shl do, and
+//the shifts are most of the time a code takes.
+__attribute__((target("bmi,bmi2")))
+static bool decodeBmi2(const uint8_t* data, size_t& pos, size_t len, int r, uint64_t numCodes, uint64_t* words,
+                       unsigned long long nbits, DecodeState& st){
+    return decodeRun(data, pos, len, r, numCodes, words, nbits, st);
+}
+#endif
+
+//picks the decode kernel for the cpu, checked once the first time it is needed.
+static DecodeKernel decodeKernel(){
+#if defined(__x86_64__)
+    static DecodeKernel kernel = __builtin_cpu_supports("bmi2") ? decodeBmi2 : decodeScalar;
+    return kernel;
+#else
+    return decodeScalar;
+#endif
+}
+
+//Reads numCodes gaps of Rice code with r low bits from the next codeBytes bytes of in and sets
+//the bit of words at every position they lead to. Every gap moves the position on by gap + 1.
+//Returns false if the code runs out first or a gap moves the position past nbits.
+//Most codes go through the decode kernel; the ones near the end of a piece of the stream,
+//and very long gaps, go through readGap one at a time.
+static bool readCode(istream& in, uint64_t codeBytes, uint64_t numCodes, int r, uint64_t* words,
+                     unsigned long long nbits){
+    CodeInput input;
+    input.in = &in;
+    input.buf.resize(CODE_CHUNK + 8);
+    input.pos = 0;
+    input.len = 0;
+    input.left = codeBytes;
+    DecodeState st;
+    st.acc = 0;
+    st.avail = 0;
+    st.at = ~0ull;
+    st.done = 0;
+    DecodeKernel kernel = decodeKernel();
+    while(st.done < numCodes){
+        if(!kernel(input.buf.data(), input.pos, input.len, r, numCodes, words, nbits, st)){
+            return false;
+        }
+        if(st.done == numCodes){
+            break;
+        }
+        uint64_t gap;
+        if(!readGap(input, st.acc, st.avail, r, gap) || gap >= nbits - (st.at + 1)){
+            return false;
+        }
+        st.at += gap + 1;
+        words[st.at >> 6] |= uint64_t(1) << (st.at & 63);
+        st.done++;
+    }
+    in.ignore(input.left);
+    return true;
+}
+
+//Decodes into the bit array of a new filter. Zeros are decoded as if they were ones and the
+//whole array is flipped afterwards.
+BloomFilter* importCompressed(istream& in, bool verify){
+    PackedFilterHeader header;
+    if(!in.read((char*) &header, sizeof(header))){
+        return NULL;
+    }
+    uint64_t nwords = (header.size + 63) / 64;
+    bool valid = memcmp(header.magic, PACKED_MAGIC, 8) == 0 && header.version == PACKED_VERSION &&
+                 header.headerChecksum == hashKey(&header, offsetof(PackedFilterHeader, headerChecksum), 0) &&
+                 header.layout <= BLOOM_BLOCKED && header.numHash > 0 &&
+                 header.size > 0 && header.size <= PACKED_MAX_SIZE &&
+                 (header.layout != BLOOM_BLOCKED || header.size % BLOCK_BITS == 0) &&
+                 header.riceBits <= 31 && header.coding <= PACKED_RAW && header.numCodes <= header.size &&
+                 (header.coding != PACKED_RAW || header.codeBytes == nwords * 8);
+    if(!valid){
+        return NULL;
+    }
+    BitArray* bits = new BitArray(header.size);
+    BloomFilter* b = new BloomFilter(header.size, header.numHash, header.seed, (BloomLayout) header.layout, false, bits);
+    b->numElem = header.numElem;
+    uint64_t* words = bits->words;
+    bool ok;
+    if(header.coding == PACKED_RAW){
+        ok = (bool) in.read((char*) words, nwords * 8);
+    }else{
+        ok = readCode(in, header.codeBytes, header.numCodes, header.riceBits, words, header.size);
+    }
+    if(ok && header.coding == PACKED_ZEROS){
+        for(uint64_t w = 0; w < nwords; w++){
+            words[w] = ~words[w];
+        }
+        if(header.size % 64 != 0){
+            words[nwords - 1] &= (uint64_t(1) << (header.size % 64)) - 1;
+        }
+    }
+    if(!ok || (verify && hashKey(words, nwords * 8, 0) != header.bitsChecksum)){
+        delete b;
+        return NULL;
+    }
+    //putting the removed keys back in the remove hash table. The section is read CODE_CHUNK bytes
+    //at a time, so a removedBytes bigger than the stream fails at its end instead of being allocated.
+    string removed;
+    vector<char> piece(CODE_CHUNK);
+    for(uint64_t left = header.removedBytes; left > 0; ){
+        size_t n = min((uint64_t) CODE_CHUNK, left);
+        if(!in.read(piece.data(), n)){
+            delete b;
+            return NULL;
+        }
+        removed.append(piece.data(), n);
+        left -= n;
+    }
+    b->loadRemoved(removed.data(), removed.size());
+    return b;
+}
@@ -0,0 +1,75 @@
+#ifndef COMPRESSED_H
+#define COMPRESSED_H
+
+#include <iostream>
+#include "bloomFilter.h"
+
+//Compressed export format for sending a bloom filter to another machine.
+//Instead of the raw bit array the positions of the 1 bits are sent as the gaps between them,
+//each gap Golomb-Rice coded: gap >> r in unary (that many 0 bits and then a 1) followed by
+//the low r bits. If more than half the bits are 1, the positions of the 0 bits are sent
+//instead. The gaps of a filter with a fraction f of its bits set are about geometric, so this
+//comes within a few percent of the entropy of the bit array, size * H(f) bits.
+//A filter made with the best number of hash functions has half its bits set and H(1/2) = 1,
+//so it can't be compressed at all, and is sent as it is. A filter made bigger with fewer hash
+//functions (c > 1 and d < 1 in the BloomFilter constructor) is sparse and compresses to fewer
+//bytes than a normal filter with the same false positive rate (Mitzenmacher, "Compressed
+//Bloom Filters"), at the cost of more memory once it's unpacked. With one hash function the
+//code is a Golomb coded set of the keys' hashes, about log2(1/p) + 1.5 bits per key where a
+//normal filter takes 1.44 log2(1/p). For a million keys:
+//  c = 1, d = 1 (k = 7):     9.6 bits per key sent, false positive rate 0.010
+//  c = 3, d = 0.3 (k = 2):  10.3 bits per key sent (a normal filter: 11.2), rate 0.0045
+//  c = 6, d = 0.15 (k = 1):  7.3 bits per key sent (a normal filter: 8.5), rate 0.017
+//When the code wouldn't be at least 1/32 smaller than the bit array, the bit array is sent as
+//it is, since it is much faster to read.
+//The file is a PackedFilterHeader, codeBytes bytes of code, and then the removed keys
+//the same as in the bloom filter file format (see BloomFileHeader). The code is made of bytes
+//read low bit first; everything else is stored in the byte order of the machine which wrote it.
+const char PACKED_MAGIC[8] = {'B','L','O','O','M','G','C','S'};
+const uint32_t PACKED_VERSION = 1;
+
+//Largest filter importCompressed takes, in bits (32 GB of bit array). The stream comes from
+//another machine, so the size in its header isn't trusted with an allocation of any size.
+const uint64_t PACKED_MAX_SIZE = uint64_t(1) << 38;
+
+//What the code after the header is.
+//PACKED_ONES: Rice coded gaps between the 1 bits
+//PACKED_ZEROS: Rice coded gaps between the 0 bits, for filters with more 1 bits than 0 bits
+//PACKED_RAW: the bit array words as they are
+enum PackedCoding { PACKED_ONES, PACKED_ZEROS, PACKED_RAW };
+
+struct PackedFilterHeader {
+    char magic[8]; //PACKED_MAGIC
+    uint32_t version; //PACKED_VERSION
+    uint32_t layout; //BloomLayout of the filter
+    uint64_t size; //size of the bloom filter in bits
+    uint64_t numHash; //number of hash functions
+    uint64_t seed; //seed of the key hash
+    uint64_t numElem; //expected number of elements
+    uint64_t numCodes; //number of gaps coded
+    uint32_t riceBits; //r, the number of low bits of each gap stored as they are
+    uint32_t coding; //PackedCoding of the code
+    uint64_t codeBytes; //bytes of code after the header
+    uint64_t numRemoved; //number of removed keys stored after the code
+    uint64_t removedBytes; //bytes of the removed keys section
+    uint64_t bitsChecksum; //hashKey of the bit array words, seed 0, the same as in the file format
+    uint64_t headerChecksum; //hashKey of all the fields above, seed 0
+};
+
+//Bytes exportCompressed would write for b, worked out without coding anything.
+//One pass over the bit array.
+unsigned long long compressedSize(BloomFilter& b);
+
+//Writes b to out in the compressed format. The bit array is read twice, once to pick r and
+//count the bytes of code and once to code it, and the code is written out a piece at a time,
+//so it never needs memory for the whole output.
+//Nothing may insert into b while it is being written. Returns false if out failed.
+bool exportCompressed(BloomFilter& b, ostream& out);
+
+//Reads a filter written by exportCompressed from in, decoding the gaps a piece of input at a
+//time straight into the new filter's bit array.
+//verify = check the bit array against the checksum once it is decoded.
+//Returns NULL if the input is cut short or isn't a valid compressed filter.
+BloomFilter* importCompressed(istream& in, bool verify = true);
+
+#endif
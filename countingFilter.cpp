@@ -0,0 +1,128 @@
+#include <iostream>
+#include <string.h>
+#include "countingFilter.h"
+
+using namespace std;
+
+//Counter array constructor.
+//n counters of bits bits each, bits has to be 4 or 8 so counters never cross a word.
+CounterArray::CounterArray(unsigned long long n, int bits){
+    this->n = n;
+    this->bits = bits;
+    max = (uint64_t(1) << bits) - 1;
+    nwords = (n * bits + 63) / 64;
+    words = new uint64_t[nwords]();
+}
+
+//counter array destructor.
+CounterArray::~CounterArray(){
+    delete[] words;
+}
+
+unsigned int CounterArray::get(unsigned long long i){
+    unsigned long long bit = i * bits;
+    return (words[bit >> 6] >> (bit & 63)) & max;
+}
+
+//adding to a counter adds 1 at the counter's lowest bit. Saturated counters are left alone
+//so the add can never carry into the next counter.
+void CounterArray::increment(unsigned long long i){
+    unsigned long long bit = i * bits;
+    if(((words[bit >> 6] >> (bit & 63)) & max) != max){
+        words[bit >> 6] += uint64_t(1) << (bit & 63);
+    }
+}
+
+//a counter at 0 has nothing to take away, and a saturated counter may be counting
+//more elements than it can show, so both are left alone.
+void CounterArray::decrement(unsigned long long i){
+    unsigned long long bit = i * bits;
+    uint64_t value = (words[bit >> 6] >> (bit & 63)) & max;
+    if(value != 0 && value != max){
+        words[bit >> 6] -= uint64_t(1) << (bit & 63);
+    }
+}
+
+//Constructor for the counting bloom filter.
+//Sizes the filter and picks the number of hash functions the same way BloomFilter does.
+CountingBloomFilter::CountingBloomFilter(double p, int m, float c, float d, int bits, uint64_t seed){
+    numElem = m;
+    size = BloomFilter::BloomFilterSize(p,m,c);
+    if(size == 0){
+        size = 1;
+    }
+    numHash = BloomFilter::numHashFunctions(size/c, numElem, d);
+    counters = new CounterArray(size, bits == 8 ? 8 : 4);
+    this->seed = seed;
+}
+
+//counting bloom filter destructor.
+CountingBloomFilter::~CountingBloomFilter(){
+    delete counters;
+}
+
+//Hash function equation = ((h1 + index * h2) * m) >> 64, the same as BloomFilter::hash
+unsigned long long CountingBloomFilter::hash(uint64_t element, int index){
+    return classicProbe(element, index, size);
+}
+
+//hashes a string into 64 bits using the seed of this filter.
+uint64_t CountingBloomFilter::keyHash(string_view element){
+    return hashKey(element.data(), element.size(), seed);
+}
+
+//inserts a string by adding 1 to each of its counters.
+void CountingBloomFilter::insert(string_view element){
+    uint64_t elem = keyHash(element);
+    for(unsigned int i = 0; i < numHash; i++){
+        counters->increment(hash(elem,i));
+    }
+}
+
+//checks if every counter of the element is above 0
+bool CountingBloomFilter::find(string_view element){
+    uint64_t elem = keyHash(element);
+    for(unsigned int i = 0; i < numHash; i++){
+        if(counters->get(hash(elem,i)) == 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+//removes an element by taking 1 from each of its counters.
+//Only does something if the element is in the filter, so removing an element
+//which was never added can't push counters of other elements down to 0.
+void CountingBloomFilter::remove(string_view element){
+    if(!find(element)){
+        return;
+    }
+    uint64_t elem = keyHash(element);
+    for(unsigned int i = 0; i < numHash; i++){
+        counters->decrement(hash(elem,i));
+    }
+}
+
+//Versions of insert, find and remove for keys given as raw bytes.
+void CountingBloomFilter::insert(const void* key, size_t len){
+    insert(string_view((const char*) key, len));
+}
+
+bool CountingBloomFilter::find(const void* key, size_t len){
+    return find(string_view((const char*) key, len));
+}
+
+void CountingBloomFilter::remove(const void* key, size_t len){
+    remove(string_view((const char*) key, len));
+}
+
+//prints out the counters
+//used for testing
+void CountingBloomFilter::print(){
+    for(unsigned long long i = 0; i < size; i++){
+        cout  << i << "," << counters->get(i) << " ";
+        if(i%10 == 0){
+            cout << endl;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef COUNTING_H
+#define COUNTING_H
+
+#include "bloomFilter.h"
+
+//Packed array of small counters for the counting bloom filter.
+//Counters are 4 or 8 bits, kept 16 or 8 to a 64 bit word.
+//A counter that reaches its max (15 or 255) is saturated and stays there,
+//since after an overflow there is no way to know how many elements share it.
+class CounterArray {
+  public:
+    CounterArray(unsigned long long n, int bits); //constructor, n counters of bits bits each, all 0
+    ~CounterArray(); //destructor
+    unsigned int get(unsigned long long i); //value of counter i
+    void increment(unsigned long long i); //adds 1 to counter i unless it is saturated
+    void decrement(unsigned long long i); //takes 1 from counter i unless it is 0 or saturated
+    unsigned long long n; //number of counters
+    int bits; //bits per counter, 4 or 8
+    uint64_t max; //value of a saturated counter
+    unsigned long long nwords; //number of 64 bit words backing the array
+    uint64_t* words; //the packed counters. counter i is bits (i*bits)%64 and up of words[i*bits/64]
+};
+
+//Bloom filter which keeps a counter per slot instead of a bit so it can really delete.
+//insert adds 1 to each of the element's k counters, remove takes 1 away, and find
+//checks that all k are above 0. Deleting is O(k) and the memory stays fixed, so there
+//is no remove hash table.
+//Unlike BloomFilter every insert counts: an element inserted twice has to be removed twice.
+//Only remove elements which were inserted. A false positive passes find, so removing one
+//takes counts away from the elements it collides with.
+class CountingBloomFilter {
+  public:
+    //constructor.
+    //p, m, c and d are the same as for BloomFilter
+    //bits = bits per counter, 4 or 8. 4 bit counters almost never saturate in a filter
+    //sized for its elements, 8 is for workloads which insert the same keys many times
+    //seed = seed of the key hash
+    CountingBloomFilter(double p, int m, float c, float d, int bits = 4, uint64_t seed = DEFAULT_SEED);
+    ~CountingBloomFilter(); //destructor
+    void insert(string_view element); //insert into the filter
+    void remove(string_view element); //removes element if find says it is in the filter
+    bool find(string_view element); //Check if a string exists in the filter
+    void insert(const void* key, size_t len); //versions for keys given as raw bytes
+    void remove(const void* key, size_t len);
+    bool find(const void* key, size_t len);
+    unsigned long long hash(uint64_t element, int index); //same double hashing as BloomFilter::hash
+    uint64_t keyHash(string_view element); //hashes a string with the filter's seed
+    void print(); //Print out the counters for testing purposes
+
+    //Data
+    unsigned int numElem; //expected number of elements
+    unsigned long long size; //number of counters
+    unsigned int numHash; //number of hash functions
+    uint64_t seed; //seed which picks the key hash function out of the family
+    CounterArray* counters; //the counters
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include "cuckooFilter.h"
+
+using namespace std;
+
+//Slots in a bucket. 4 gives the best space for rates between about 0.00001 and 0.002 in the
+//paper, and lets the table fill to 95 percent.
+const int SLOTS = 4;
+
+//How many fingerprints an insert kicks before it gives up on finding room.
+const int MAX_KICKS = 500;
+
+//Constructor for the cuckoo filter.
+//Buckets are a power of two so the alternate bucket of a fingerprint is an xor, which works
+//in both directions.
+CuckooFilter::CuckooFilter(int m, int bits, uint64_t seed){
+    this->bits = bits < 4 ? 4 : (bits > 16 ? 16 : bits);
+    mask = (uint64_t(1) << this->bits) - 1;
+    unsigned long long needed = (unsigned long long) ceil(max(m, 1) / (SLOTS * 0.95));
+    numBuckets = 1;
+    while(numBuckets < needed){
+        numBuckets *= 2;
+    }
+    count = 0;
+    this->seed = seed;
+    rng = seed ^ 0x2545f4914f6cdd1dull;
+    //a bucket is read and written as the 8 bytes it starts in, so there are 8 bytes of padding
+    table = new uint8_t[bytes() + 8]();
+    hasVictim = false;
+    victim = 0;
+    victimBucket = 0;
+}
+
+//cuckoo filter destructor.
+CuckooFilter::~CuckooFilter(){
+    delete[] table;
+}
+
+//The paper's rate is 2 * SLOTS / 2^bits, so bits = log2(8 / p), rounded up.
+int CuckooFilter::fingerprintBits(double p){
+    int bits = (int) ceil(log2(2 * SLOTS / p));
+    return bits < 4 ? 4 : (bits > 16 ? 16 : bits);
+}
+
+//hashes a string into 64 bits using the seed of this filter.
+uint64_t CuckooFilter::keyHash(string_view element){
+    return hashKey(element.data(), element.size(), seed);
+}
+
+//A bucket is 4 * bits bits starting at a multiple of 4 bits, so it starts 0 or 4 bits into
+//a byte and always fits in the 8 bytes from there (16 bit fingerprints always start on a byte).
+uint64_t CuckooFilter::readBucket(unsigned long long i){
+    unsigned long long bit = i * SLOTS * bits;
+    uint64_t word;
+    memcpy(&word, table + (bit >> 3), 8);
+    word >>= bit & 7;
+    return bits == 16 ? word : word & ((uint64_t(1) << (SLOTS * bits)) - 1);
+}
+
+void CuckooFilter::writeBucket(unsigned long long i, uint64_t value){
+    unsigned long long bit = i * SLOTS * bits;
+    uint64_t bucketMask = bits == 16 ? ~uint64_t(0) : (uint64_t(1) << (SLOTS * bits)) - 1;
+    uint64_t word;
+    memcpy(&word, table + (bit >> 3), 8);
+    word &= ~(bucketMask << (bit & 7));
+    word |= value << (bit & 7);
+    memcpy(table + (bit >> 3), &word, 8);
+}
+
+bool CuckooFilter::addTo(unsigned long long i, uint64_t fp){
+    uint64_t b = readBucket(i);
+    for(int j = 0; j < SLOTS; j++){
+        if(((b >> (j * bits)) & mask) == 0){
+            writeBucket(i, b | (fp << (j * bits)));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::removeFrom(unsigned long long i, uint64_t fp){
+    uint64_t b = readBucket(i);
+    for(int j = 0; j < SLOTS; j++){
+        if(((b >> (j * bits)) & mask) == fp){
+            writeBucket(i, b & ~(mask << (j * bits)));
+            return true;
+        }
+    }
+    return false;
+}
+
+//all 4 slots are compared without branching
+bool CuckooFilter::inBucket(unsigned long long i, uint64_t fp){
+    uint64_t b = readBucket(i);
+    bool found = false;
+    for(int j = 0; j < SLOTS; j++){
+        found |= ((b >> (j * bits)) & mask) == fp;
+    }
+    return found;
+}
+
+//The alternate bucket is the bucket xor a hash of the fingerprint. The multiply scrambles
+//the fingerprint so fingerprints which differ in a few bits go to far apart buckets.
+unsigned long long CuckooFilter::altBucket(unsigned long long i, uint64_t fp){
+    return (i ^ ((fp * 0x5bd1e9955bd1e995ull) >> 32)) & (numBuckets - 1);
+}
+
+//A key's fingerprint is the top bits of its hash and its first bucket is from the low bits,
+//so the two don't depend on each other. 0 marks an empty slot, so fingerprints are never 0.
+static inline void fingerprintAndBucket(uint64_t h, int bits, unsigned long long numBuckets,
+                                        uint64_t& fp, unsigned long long& bucket){
+    fp = h >> (64 - bits);
+    fp += fp == 0;
+    bucket = h & (numBuckets - 1);
+}
+
+//inserts a string.
+//Tries both buckets, then kicks a random fingerprint out of one of them to its other bucket
+//and places the new one in its slot, repeating with the kicked fingerprint.
+//If the kicks run out, the fingerprint left over is kept as the victim so no key is lost;
+//while there is a victim the filter is full.
+bool CuckooFilter::insert(string_view element){
+    if(hasVictim){
+        return false;
+    }
+    uint64_t fp;
+    unsigned long long i1;
+    fingerprintAndBucket(keyHash(element), bits, numBuckets, fp, i1);
+    unsigned long long i2 = altBucket(i1, fp);
+    if(addTo(i1, fp) || addTo(i2, fp)){
+        count++;
+        return true;
+    }
+    //xorshift picks the bucket to start kicking from and the slot to kick
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    unsigned long long i = (rng & 1) ? i1 : i2;
+    for(int kick = 0; kick < MAX_KICKS; kick++){
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        int j = rng % SLOTS;
+        uint64_t b = readBucket(i);
+        uint64_t old = (b >> (j * bits)) & mask;
+        writeBucket(i, (b & ~(mask << (j * bits))) | (fp << (j * bits)));
+        fp = old;
+        i = altBucket(i, fp);
+        if(addTo(i, fp)){
+            count++;
+            return true;
+        }
+    }
+    hasVictim = true;
+    victim = fp;
+    victimBucket = i;
+    count++;
+    return true;
+}
+
+//checks if an element is in the filter by looking at its 2 buckets and the victim.
+bool CuckooFilter::find(string_view element){
+    uint64_t fp;
+    unsigned long long i1;
+    fingerprintAndBucket(keyHash(element), bits, numBuckets, fp, i1);
+    unsigned long long i2 = altBucket(i1, fp);
+    bool found = inBucket(i1, fp) | inBucket(i2, fp);
+    if(hasVictim && victim == fp && (victimBucket == i1 || victimBucket == i2)){
+        found = true;
+    }
+    return found;
+}
+
+//removes one copy of the element's fingerprint from one of its buckets.
+//A slot freed up means the victim might fit again, so it gets another try.
+bool CuckooFilter::remove(string_view element){
+    uint64_t fp;
+    unsigned long long i1;
+    fingerprintAndBucket(keyHash(element), bits, numBuckets, fp, i1);
+    unsigned long long i2 = altBucket(i1, fp);
+    bool removed = false;
+    if(hasVictim && victim == fp && (victimBucket == i1 || victimBucket == i2)){
+        hasVictim = false;
+        removed = true;
+    }else{
+        removed = removeFrom(i1, fp) || removeFrom(i2, fp);
+    }
+    if(!removed){
+        return false;
+    }
+    count--;
+    if(hasVictim && (addTo(victimBucket, victim) || addTo(altBucket(victimBucket, victim), victim))){
+        hasVictim = false;
+    }
+    return true;
+}
+
+//Versions of insert, find and remove for keys given as raw bytes.
+bool CuckooFilter::insert(const void* key, size_t len){
+    return insert(string_view((const char*) key, len));
+}
+
+bool CuckooFilter::find(const void* key, size_t len){
+    return find(string_view((const char*) key, len));
+}
+
+bool CuckooFilter::remove(const void* key, size_t len){
+    return remove(string_view((const char*) key, len));
+}
+
+//fraction of the slots in use
+double CuckooFilter::loadFactor(){
+    return double(count) / (numBuckets * SLOTS);
+}
+
+//bytes of buckets, not counting the padding
+unsigned long long CuckooFilter::bytes(){
+    return (numBuckets * SLOTS * bits + 7) / 8;
+}
+
+//prints out the fingerprints of every bucket
+//used for testing
+void CuckooFilter::print(){
+    for(unsigned long long i = 0; i < numBuckets; i++){
+        uint64_t b = readBucket(i);
+        cout << i << ":";
+        for(int j = 0; j < SLOTS; j++){
+            cout << " " << ((b >> (j * bits)) & mask);
+        }
+        cout << endl;
+    }
+}
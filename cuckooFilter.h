@@ -0,0 +1,62 @@
+#ifndef CUCKOO_H
+#define CUCKOO_H
+
+#include "bloomFilter.h"
+
+//Cuckoo filter (Fan, Andersen, Kaminsky and Mitzenmacher, 2014).
+//Stores a small fingerprint of every key in a table of buckets with 4 slots each. A key can
+//be in one of two buckets, and the second is the first xor a hash of the fingerprint
+//("partial-key cuckoo hashing"), so either bucket can be found from the other without the key.
+//When both buckets are full, a fingerprint already in them is kicked to its other bucket,
+//which may kick another, and so on.
+//find checks 8 slots in 2 buckets, and remove takes the fingerprint out of its bucket, so
+//deleting is O(1) without a remove hash table. The false positive rate is about 8 / 2^bits,
+//and at rates below about 3% it needs fewer bits per key than a bloom filter, and about a
+//quarter of what a counting bloom filter needs.
+//Like CountingBloomFilter, every insert counts: only remove keys which were inserted, and a key
+//inserted twice has to be removed twice. Removing a false positive removes the key it collides with.
+class CuckooFilter {
+  public:
+    //constructor.
+    //m = number of keys the filter has to hold. The table is sized to hold them at
+    //95 percent full, rounded up to a power of two buckets
+    //bits = bits per fingerprint, 4 to 16. fingerprintBits picks it for a false positive rate
+    //seed = seed of the key hash
+    CuckooFilter(int m, int bits = 12, uint64_t seed = DEFAULT_SEED);
+    ~CuckooFilter(); //destructor
+    //inserts into the filter. Returns false if the filter is too full to take it; it is
+    //unchanged then, and every key inserted before is still found.
+    bool insert(string_view element);
+    bool remove(string_view element); //removes one copy of element. Returns false if it isn't in the filter
+    bool find(string_view element); //Check if a string exists in the filter
+    bool insert(const void* key, size_t len); //versions for keys given as raw bytes
+    bool remove(const void* key, size_t len);
+    bool find(const void* key, size_t len);
+    uint64_t keyHash(string_view element); //hashes a string with the filter's seed
+    static int fingerprintBits(double p); //fingerprint bits for a false positive rate of p
+    double loadFactor(); //fraction of the slots which are full
+    unsigned long long bytes(); //bytes used by the table
+    void print(); //Print out the buckets for testing purposes
+
+    //Data
+    int bits; //bits per fingerprint
+    uint64_t mask; //value of a fingerprint with every bit set
+    unsigned long long numBuckets; //number of buckets, a power of two
+    unsigned long long count; //number of fingerprints in the filter
+    uint64_t seed; //seed which picks the key hash function out of the family
+    uint64_t rng; //state of the generator picking which fingerprint to kick
+    uint8_t* table; //the buckets, packed 4 * bits bits each. bucket i starts at bit i * 4 * bits
+    bool hasVictim; //true if a fingerprint couldn't be placed by the last insert that ran out of kicks
+    uint64_t victim; //that fingerprint
+    unsigned long long victimBucket; //one of its two buckets
+
+  private:
+    uint64_t readBucket(unsigned long long i); //the 4 fingerprints of bucket i, slot j at bits j * bits
+    void writeBucket(unsigned long long i, uint64_t value); //stores the 4 fingerprints of bucket i
+    bool addTo(unsigned long long i, uint64_t fp); //puts fp in an empty slot of bucket i if it has one
+    bool removeFrom(unsigned long long i, uint64_t fp); //takes one copy of fp out of bucket i
+    bool inBucket(unsigned long long i, uint64_t fp); //true if bucket i has fp
+    unsigned long long altBucket(unsigned long long i, uint64_t fp); //the other bucket of fp in bucket i
+};
+
+#endif
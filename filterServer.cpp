@@ -0,0 +1,555 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include "filterServer.h"
+
+using namespace std;
+
+//Bytes a connection reads at a time. Grown for a request bigger than this.
+const size_t SERVER_READ = 64 << 10;
+
+//Most epoll events handled per wait.
+const int SERVER_EVENTS = 64;
+
+FilterServer::FilterServer(){
+    listenFd = -1;
+    epollFd = -1;
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+FilterServer::~FilterServer(){
+    for(ServerConnection* c : conns){
+        if(c != NULL){
+            drop(c);
+        }
+    }
+    if(listenFd >= 0){
+        ::close(listenFd);
+    }
+    if(epollFd >= 0){
+        ::close(epollFd);
+    }
+    if(wakeFd >= 0){
+        ::close(wakeFd);
+    }
+    if(!socketPath.empty()){
+        unlink(socketPath.c_str());
+    }
+    for(auto& f : filters){
+        delete f.second;
+    }
+}
+
+void FilterServer::addFilter(const string& name, BloomFilter* b){
+    auto it = filters.find(name);
+    if(it != filters.end()){
+        delete it->second;
+    }
+    filters[name] = b;
+}
+
+bool FilterServer::listenUnix(const char* path){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+    //a socket file left by a server which didn't exit cleanly would make bind fail, but
+    //anything which isn't a socket is left alone
+    struct stat st;
+    if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode)){
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        return false;
+    }
+    if(bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0){
+        ::close(fd);
+        return false;
+    }
+    if(!listenOn(fd)){
+        unlink(path);
+        return false;
+    }
+    socketPath = path;
+    return true;
+}
+
+bool FilterServer::listenTcp(int port){
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0){
+        ::close(fd);
+        return false;
+    }
+    return listenOn(fd);
+}
+
+bool FilterServer::listenOn(int fd){
+    if(listen(fd, SOMAXCONN) != 0){
+        ::close(fd);
+        return false;
+    }
+    if(listenFd >= 0){
+        ::close(listenFd);
+    }
+    listenFd = fd;
+    return true;
+}
+
+bool FilterServer::run(){
+    if(listenFd < 0 || wakeFd < 0){
+        return false;
+    }
+    if(epollFd < 0){
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if(epollFd < 0){
+            return false;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+    struct epoll_event events[SERVER_EVENTS];
+    bool running = true;
+    while(running){
+        int n = epoll_wait(epollFd, events, SERVER_EVENTS, -1);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        for(int i = 0; i < n; i++){
+            int fd = events[i].data.fd;
+            if(fd == wakeFd){
+                uint64_t count;
+                if(read(wakeFd, &count, sizeof(count)) < 0){
+                    //another wakeup already read it, stopping either way
+                }
+                running = false;
+                continue;
+            }
+            if(fd == listenFd){
+                acceptAll();
+                continue;
+            }
+            ServerConnection* c = fd < (int) conns.size() ? conns[fd] : NULL;
+            if(c == NULL){
+                continue;
+            }
+            uint32_t e = events[i].events;
+            //a hang up can come with the last requests still to be read, so read first
+            if((e & (EPOLLERR | EPOLLHUP)) && !(e & EPOLLIN)){
+                drop(c);
+                continue;
+            }
+            if((e & EPOLLOUT) && !writeTo(c)){
+                continue;
+            }
+            if(e & EPOLLIN){
+                readFrom(c);
+            }
+        }
+    }
+    return true;
+}
+
+void FilterServer::stop(){
+    //write is safe in a signal handler
+    uint64_t one = 1;
+    if(write(wakeFd, &one, sizeof(one)) < 0){
+        //the counter is already non zero, so run is waking up anyway
+    }
+}
+
+void FilterServer::acceptAll(){
+    while(true){
+        int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0){
+            //EAGAIN once every waiting connection is accepted; on any other error (out of
+            //file descriptors) the rest are accepted on the next wakeup
+            return;
+        }
+        //lookups are small requests, so don't hold them back waiting for more to send
+        //(fails harmlessly on a Unix domain socket)
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ServerConnection* c = new ServerConnection;
+        c->fd = fd;
+        c->in.resize(SERVER_READ);
+        c->inHave = 0;
+        c->outSent = 0;
+        c->events = EPOLLIN;
+        struct epoll_event ev;
+        ev.events = c->events;
+        ev.data.fd = fd;
+        if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0){
+            ::close(fd);
+            delete c;
+            continue;
+        }
+        if(fd >= (int) conns.size()){
+            conns.resize(fd + 1, NULL);
+        }
+        conns[fd] = c;
+    }
+}
+
+bool FilterServer::readFrom(ServerConnection* c){
+    while(c->out.size() - c->outSent < SERVER_MAX_PENDING){
+        size_t room = c->in.size() - c->inHave;
+        ssize_t n = recv(c->fd, c->in.data() + c->inHave, room, 0);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK){
+                break;
+            }
+            drop(c);
+            return false;
+        }
+        if(n == 0){
+            //the client closed its end, so no one is left to read the replies
+            drop(c);
+            return false;
+        }
+        c->inHave += n;
+        //handles every whole request read so far
+        size_t pos = 0;
+        size_t need = 0;
+        while(c->inHave - pos >= sizeof(ServerRequest)){
+            ServerRequest req;
+            memcpy(&req, c->in.data() + pos, sizeof(req));
+            if(req.bytes > SERVER_MAX_REQUEST){
+                drop(c);
+                return false;
+            }
+            size_t whole = sizeof(req) + req.bytes;
+            if(c->inHave - pos < whole){
+                need = whole;
+                break;
+            }
+            handle(c, req, c->in.data() + pos + sizeof(req));
+            pos += whole;
+        }
+        memmove(c->in.data(), c->in.data() + pos, c->inHave - pos);
+        c->inHave -= pos;
+        if(need > c->in.size()){
+            c->in.resize(need);
+        }else if(need == 0 && c->in.size() > SERVER_READ){
+            //done with a big request, give its memory back
+            c->in.resize(max(c->inHave, SERVER_READ));
+            c->in.shrink_to_fit();
+        }
+        //a short read means there is nothing more to read for now
+        if((size_t) n < room){
+            break;
+        }
+    }
+    return writeTo(c);
+}
+
+void FilterServer::handle(ServerConnection* c, const ServerRequest& req, const char* p){
+    ServerReply reply;
+    reply.bytes = 0;
+    reply.status = SERVER_OK;
+    reply.op = req.op;
+    reply.count = req.count;
+    reply.id = req.id;
+    //the name and key lengths have to fit in the request, and the keys fill the rest of it
+    const char* end = p + req.bytes;
+    const char* lengths = p + req.nameLen;
+    const char* key = lengths + 4 * uint64_t(req.count);
+    if(req.op > SERVER_REMOVE || req.nameLen + 4 * uint64_t(req.count) > req.bytes){
+        reply.status = SERVER_BAD_REQUEST;
+    }else{
+        keys.resize(req.count);
+        for(uint32_t j = 0; j < req.count; j++){
+            uint32_t len;
+            memcpy(&len, lengths + 4 * size_t(j), 4);
+            if(len > size_t(end - key)){
+                reply.status = SERVER_BAD_REQUEST;
+                break;
+            }
+            keys[j] = string_view(key, len);
+            key += len;
+        }
+        if(key != end){
+            reply.status = SERVER_BAD_REQUEST;
+        }
+    }
+    BloomFilter* b = NULL;
+    if(reply.status == SERVER_OK){
+        auto it = filters.find(string(p, req.nameLen));
+        if(it == filters.end()){
+            reply.status = SERVER_NO_FILTER;
+        }else{
+            b = it->second;
+        }
+    }
+    size_t start = c->out.size();
+    if(b != NULL && req.op == SERVER_FIND){
+        size_t words = (req.count + 63) / 64;
+        reply.bytes = words * 8;
+        c->out.resize(start + sizeof(reply) + reply.bytes);
+        found.resize(words);
+        if(words > 0){
+            b->findMany(keys.data(), req.count, found.data());
+            memcpy(c->out.data() + start + sizeof(reply), found.data(), reply.bytes);
+        }
+    }else{
+        c->out.resize(start + sizeof(reply));
+        if(b != NULL && req.op == SERVER_INSERT){
+            b->insertMany(keys.data(), req.count);
+        }else if(b != NULL && req.op == SERVER_REMOVE){
+            for(uint32_t j = 0; j < req.count; j++){
+                b->remove(keys[j]);
+            }
+        }
+    }
+    memcpy(c->out.data() + start, &reply, sizeof(reply));
+}
+
+bool FilterServer::writeTo(ServerConnection* c){
+    while(c->outSent < c->out.size()){
+        ssize_t n = send(c->fd, c->out.data() + c->outSent, c->out.size() - c->outSent, MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK){
+                break;
+            }
+            drop(c);
+            return false;
+        }
+        c->outSent += n;
+    }
+    if(c->outSent == c->out.size()){
+        c->out.clear();
+        c->outSent = 0;
+    }else if(c->outSent >= c->out.size() / 2){
+        //the client is reading slowly, so keep the buffer from growing with sent bytes
+        c->out.erase(c->out.begin(), c->out.begin() + c->outSent);
+        c->outSent = 0;
+    }
+    watch(c);
+    return true;
+}
+
+void FilterServer::watch(ServerConnection* c){
+    uint32_t want = 0;
+    size_t pending = c->out.size() - c->outSent;
+    if(pending < SERVER_MAX_PENDING){
+        want |= EPOLLIN;
+    }
+    if(pending > 0){
+        want |= EPOLLOUT;
+    }
+    if(want != c->events){
+        struct epoll_event ev;
+        ev.events = want;
+        ev.data.fd = c->fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->events = want;
+    }
+}
+
+void FilterServer::drop(ServerConnection* c){
+    if(epollFd >= 0){
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+    }
+    ::close(c->fd);
+    conns[c->fd] = NULL;
+    delete c;
+}
+
+FilterClient::FilterClient(){
+    fd = -1;
+    in.resize(SERVER_READ);
+    inStart = 0;
+    inHave = 0;
+    nextId = 0;
+}
+
+FilterClient::~FilterClient(){
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+bool FilterClient::connectUnix(const char* path){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        return false;
+    }
+    if(connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0){
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool FilterClient::connectTcp(int port){
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        return false;
+    }
+    if(connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0){
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+}
+
+uint32_t FilterClient::queue(ServerOp op, string_view name, const string_view* keys, size_t n){
+    ServerRequest req;
+    size_t keyBytes = 0;
+    for(size_t j = 0; j < n; j++){
+        keyBytes += keys[j].size();
+    }
+    //a name or request too big for the header's fields is sent cut short, and the server
+    //answers it with SERVER_BAD_REQUEST or disconnects
+    req.bytes = name.size() + 4 * n + keyBytes;
+    req.op = op;
+    req.nameLen = name.size();
+    req.count = n;
+    req.id = nextId++;
+    size_t start = out.size();
+    out.resize(start + sizeof(req) + name.size() + 4 * n + keyBytes);
+    char* p = out.data() + start;
+    memcpy(p, &req, sizeof(req));
+    p += sizeof(req);
+    memcpy(p, name.data(), name.size());
+    p += name.size();
+    for(size_t j = 0; j < n; j++){
+        uint32_t len = keys[j].size();
+        memcpy(p, &len, 4);
+        p += 4;
+    }
+    for(size_t j = 0; j < n; j++){
+        memcpy(p, keys[j].data(), keys[j].size());
+        p += keys[j].size();
+    }
+    return req.id;
+}
+
+bool FilterClient::flush(){
+    size_t sent = 0;
+    while(sent < out.size()){
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return false;
+        }
+        sent += n;
+    }
+    out.clear();
+    return true;
+}
+
+bool FilterClient::receive(ServerReply& reply, vector<uint64_t>& found){
+    while(true){
+        if(inHave - inStart >= sizeof(reply)){
+            memcpy(&reply, in.data() + inStart, sizeof(reply));
+            size_t whole = sizeof(reply) + reply.bytes;
+            if(inHave - inStart >= whole){
+                found.resize(reply.bytes / 8);
+                //most replies have no words, and memcpy mustn't be given found's null data then
+                if(!found.empty()){
+                    memcpy(found.data(), in.data() + inStart + sizeof(reply), found.size() * 8);
+                }
+                inStart += whole;
+                return true;
+            }
+            if(whole > in.size()){
+                in.resize(whole);
+            }
+        }
+        //moves the start of the next reply to the front to make room
+        if(inHave == in.size() || inStart == inHave){
+            memmove(in.data(), in.data() + inStart, inHave - inStart);
+            inHave -= inStart;
+            inStart = 0;
+        }
+        ssize_t n = recv(fd, in.data() + inHave, in.size() - inHave, 0);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return false;
+        }
+        inHave += n;
+    }
+}
+
+bool FilterClient::call(ServerOp op, string_view name, const string_view* keys, size_t n, uint64_t* found){
+    uint32_t id = queue(op, name, keys, n);
+    ServerReply reply;
+    if(!flush() || !receive(reply, scratch)){
+        return false;
+    }
+    if(reply.id != id || reply.status != SERVER_OK){
+        return false;
+    }
+    if(found != NULL && n > 0){
+        memcpy(found, scratch.data(), (n + 63) / 64 * 8);
+    }
+    return true;
+}
+
+bool FilterClient::find(string_view name, const string_view* keys, size_t n, uint64_t* found){
+    return call(SERVER_FIND, name, keys, n, found);
+}
+
+bool FilterClient::insert(string_view name, const string_view* keys, size_t n){
+    return call(SERVER_INSERT, name, keys, n, NULL);
+}
+
+bool FilterClient::remove(string_view name, const string_view* keys, size_t n){
+    return call(SERVER_REMOVE, name, keys, n, NULL);
+}
@@ -0,0 +1,145 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "bloomFilter.h"
+
+//Local filter server, so the processes on a machine can share filters instead of each
+//building its own copy from the text files.
+//One thread runs an epoll loop over a Unix domain socket (or a TCP port on 127.0.0.1) and
+//serves insert, find and remove on named filters held in memory.
+//Requests are batches of keys, and a client may send many requests without waiting for the
+//replies (pipelining). The server handles every whole request it has read before writing
+//the replies back in one go, in the order the requests came in, so a batch costs one
+//system call each way however many keys it has.
+//The server is only meant for processes on the same machine: numbers are in the byte order of
+//the machine and nothing is authenticated, so anyone who can open the socket can use every
+//filter. Give the socket file permissions to match.
+
+//Operations.
+enum ServerOp { SERVER_FIND, SERVER_INSERT, SERVER_REMOVE };
+
+//Reply status.
+//SERVER_OK: done
+//SERVER_NO_FILTER: no filter with that name
+//SERVER_BAD_REQUEST: unknown op, or the keys don't add up to the request's length
+enum ServerStatus { SERVER_OK, SERVER_NO_FILTER, SERVER_BAD_REQUEST };
+
+//Largest request the server takes, in bytes after the header. A client sending a bigger one
+//is disconnected.
+const uint32_t SERVER_MAX_REQUEST = 64 << 20;
+
+//Bytes of replies a connection may have waiting to be sent before the server stops reading
+//its requests, so a client which sends but never reads can't use up the server's memory.
+const size_t SERVER_MAX_PENDING = 16 << 20;
+
+//A request is this header, then nameLen bytes of filter name, count uint32_t key lengths and
+//then the keys one after another.
+struct ServerRequest {
+    uint32_t bytes; //bytes after the header
+    uint16_t op; //ServerOp
+    uint16_t nameLen; //bytes of filter name
+    uint32_t count; //number of keys
+    uint32_t id; //picked by the client and sent back in the reply
+};
+
+//A reply is this header, and for a find which succeeded (count + 63) / 64 uint64_t words,
+//bit i of them set if key i is in the filter (the same as BloomFilter::findMany).
+struct ServerReply {
+    uint32_t bytes; //bytes after the header
+    uint16_t status; //ServerStatus
+    uint16_t op; //op of the request
+    uint32_t count; //number of keys of the request
+    uint32_t id; //id of the request
+};
+
+//One client connection of the server.
+struct ServerConnection {
+    int fd; //socket
+    vector<char> in; //bytes read which aren't a whole request yet
+    size_t inHave; //bytes of in used
+    vector<char> out; //replies not sent yet
+    size_t outSent; //bytes of out already sent
+    uint32_t events; //epoll events the connection is registered for
+};
+
+class FilterServer {
+  public:
+    FilterServer(); //constructor
+    ~FilterServer(); //destructor, closes every socket and deletes the filters
+    //Serves b under name. The server deletes it.
+    void addFilter(const string& name, BloomFilter* b);
+    //Listens on a Unix domain socket at path, replacing a socket file left there.
+    //Returns false if it couldn't.
+    bool listenUnix(const char* path);
+    //Listens on port of 127.0.0.1. Returns false if it couldn't.
+    bool listenTcp(int port);
+    //Serves clients until stop is called. Returns false if the loop couldn't start.
+    bool run();
+    //Makes run return. Safe to call from any thread or from a signal handler.
+    void stop();
+
+    //Data
+    unordered_map<string, BloomFilter*> filters; //filters served, by name
+    int listenFd; //listening socket
+    int epollFd; //epoll instance
+    int wakeFd; //eventfd written by stop
+    string socketPath; //path of the Unix domain socket, removed by the destructor
+    vector<ServerConnection*> conns; //connections by socket, NULL where there is none
+    //scratch space for a request's keys and a find's results, kept to not allocate per request
+    vector<string_view> keys;
+    vector<uint64_t> found;
+
+  private:
+    bool listenOn(int fd); //starts listening on a bound socket
+    void acceptAll(); //accepts every waiting connection
+    //Reads and handles the requests of a connection. Returns false if it was closed.
+    bool readFrom(ServerConnection* c);
+    //Handles one whole request at p and appends its reply to c's output.
+    void handle(ServerConnection* c, const ServerRequest& req, const char* p);
+    //Sends as much of a connection's output as it takes. Returns false if it was closed.
+    bool writeTo(ServerConnection* c);
+    void watch(ServerConnection* c); //registers for the events the connection needs now
+    void drop(ServerConnection* c); //closes a connection
+};
+
+//Client of a FilterServer.
+//find, insert and remove send one request and wait for its reply. To pipeline, queue any
+//number of requests, flush them, and receive their replies in the same order. Receive the
+//replies before the server has SERVER_MAX_PENDING bytes of them waiting (about 128 million
+//keys of finds), or it stops reading and flush never returns. A blocking call made while
+//pipelined replies are still waiting fails.
+class FilterClient {
+  public:
+    FilterClient(); //constructor
+    ~FilterClient(); //destructor, closes the connection
+    bool connectUnix(const char* path); //connects to a server's Unix domain socket
+    bool connectTcp(int port); //connects to a server on port of 127.0.0.1
+    //Adds a request for n keys to the send buffer and returns its id. Nothing is sent until flush.
+    uint32_t queue(ServerOp op, string_view name, const string_view* keys, size_t n);
+    bool flush(); //sends every queued request. Returns false if the connection failed.
+    //Waits for the next reply. found gets the words of a find's result.
+    //Returns false if the connection failed.
+    bool receive(ServerReply& reply, vector<uint64_t>& found);
+    //One request each. found works the same as in BloomFilter::findMany.
+    //Return false if the connection failed or the server didn't reply SERVER_OK.
+    bool find(string_view name, const string_view* keys, size_t n, uint64_t* found);
+    bool insert(string_view name, const string_view* keys, size_t n);
+    bool remove(string_view name, const string_view* keys, size_t n);
+
+    //Data
+    int fd; //socket, -1 if not connected
+    vector<char> out; //queued requests
+    vector<char> in; //bytes read which weren't returned by receive yet
+    size_t inStart; //first byte of in not returned by receive yet
+    size_t inHave; //bytes of in used
+    uint32_t nextId; //id of the next request
+    vector<uint64_t> scratch; //results of the blocking find
+
+  private:
+    bool call(ServerOp op, string_view name, const string_view* keys, size_t n, uint64_t* found);
+};
+
+#endif
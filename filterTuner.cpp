@@ -0,0 +1,229 @@
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "filterTuner.h"
+
+using namespace std;
+
+//Most hash functions a candidate may have.
+const unsigned int TUNE_MAX_K = 24;
+
+//Biggest filter the tuner will consider, in bits (2^45 bits is 4 TB).
+const unsigned long long TUNE_MAX_BITS = 1ull << 45;
+
+//Keys looked up in each timed round of calibration, half inserted and half not.
+const size_t TUNE_SAMPLE = 1 << 16;
+
+TuneGoal::TuneGoal(unsigned long long elements){
+    this->elements = elements;
+    fpr = 0;
+    maxBytes = 0;
+    maxLookupNs = 0;
+    calibrate = false;
+}
+
+unsigned long long TuneChoice::bytes(){
+    return (size + 63) / 64 * 8;
+}
+
+//sizes are whole words for the classic layout and whole blocks for the blocked layout
+static unsigned long long sizeStep(BloomLayout layout){
+    return layout == BLOOM_BLOCKED ? BLOCK_BITS : 64;
+}
+
+//Smallest size (in whole steps) whose expected false positive rate with k hash functions and n
+//elements is at most p, or 0 if even TUNE_MAX_BITS isn't enough.
+//The rate only goes down as the size goes up, so this is a bisection. It starts from the classic
+//size for k, m = -kn / ln(1 - p^(1/k)), which the blocked layout needs a bit more than.
+static unsigned long long smallestSize(BloomLayout layout, unsigned int k, double n, double p){
+    unsigned long long step = sizeStep(layout);
+    double guess = -double(k) * n / log1p(-pow(p, 1.0 / k));
+    if(!(guess < TUNE_MAX_BITS)){
+        return 0;
+    }
+    unsigned long long hi = max((unsigned long long) guess / step, 1ull);
+    while(BloomFilter::expectedFpr(layout, hi * step, k, n) > p){
+        if(hi * step >= TUNE_MAX_BITS){
+            return 0;
+        }
+        hi *= 2;
+    }
+    unsigned long long lo = 0;
+    while(hi - lo > 1){
+        unsigned long long mid = lo + (hi - lo) / 2;
+        if(BloomFilter::expectedFpr(layout, mid * step, k, n) <= p){
+            hi = mid;
+        }else{
+            lo = mid;
+        }
+    }
+    return hi * step;
+}
+
+//Adds the candidates of one layout. With a false positive rate, that's the k which needs the
+//least memory and the two k below it with the memory they each need: fewer hash functions
+//take more bits but make lookups cheaper. With only a memory limit, it's the k with the lowest
+//rate in the whole memory and the two below it.
+static void addCandidates(const TuneGoal& goal, BloomLayout layout, vector<TuneChoice>& candidates){
+    double n = goal.elements;
+    unsigned long long sizes[TUNE_MAX_K + 1];
+    unsigned int best = 0;
+    if(goal.fpr > 0){
+        for(unsigned int k = 1; k <= TUNE_MAX_K; k++){
+            sizes[k] = smallestSize(layout, k, n, goal.fpr);
+            if(sizes[k] != 0 && (best == 0 || sizes[k] < sizes[best])){
+                best = k;
+            }
+        }
+    }else{
+        unsigned long long size = goal.maxBytes * 8 / sizeStep(layout) * sizeStep(layout);
+        if(size == 0){
+            return;
+        }
+        double lowest = 2;
+        for(unsigned int k = 1; k <= TUNE_MAX_K; k++){
+            sizes[k] = size;
+            double rate = BloomFilter::expectedFpr(layout, size, k, n);
+            if(rate < lowest){
+                lowest = rate;
+                best = k;
+            }
+        }
+    }
+    for(unsigned int k = best; k >= 1 && k + 2 >= best; k--){
+        if(sizes[k] == 0){
+            continue;
+        }
+        TuneChoice c;
+        c.layout = layout;
+        c.size = sizes[k];
+        c.numHash = k;
+        c.fpr = BloomFilter::expectedFpr(layout, c.size, k, n);
+        c.lookupNs = 0;
+        c.meetsGoal = goal.maxBytes == 0 || c.bytes() <= goal.maxBytes;
+        candidates.push_back(c);
+    }
+}
+
+//Sets about fill of the bits of a bit array at random, the way n elements would.
+//Each word is made from 8 random words, one for each binary digit of fill: starting from the
+//last digit, the word is or-ed with a random word for a 1 and and-ed with one for a 0, which
+//leaves each bit set with probability fill to within 1/256.
+static void randomFill(BitArray* bits, double fill){
+    unsigned int digits = (unsigned int) lround(fill * 256);
+    uint64_t rng = 0x9e3779b97f4a7c15ull;
+    for(unsigned long long w = 0; w < bits->nwords; w++){
+        uint64_t x = 0;
+        for(int d = 0; d < 8; d++){
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            x = ((digits >> d) & 1) ? (x | rng) : (x & rng);
+        }
+        bits->words[w] = digits >= 256 ? ~uint64_t(0) : x;
+    }
+}
+
+//Times lookups in a filter like the candidate once it is full: a bit array of its size with
+//as many bits set at random as n elements would set, plus TUNE_SAMPLE / 2 keys inserted so
+//half the lookups find their key. Lookups alternate between inserted keys and keys which never
+//were, spread over the whole filter. Returns the ns per lookup of the fastest of 3 rounds.
+static double timeLookups(const TuneChoice& c, double n){
+    BloomFilter b(c.size, c.numHash, DEFAULT_SEED, c.layout);
+    randomFill(b.bt, 1 - exp(-double(c.numHash) * n / c.size));
+    vector<uint64_t> keys(TUNE_SAMPLE);
+    for(size_t j = 0; j < TUNE_SAMPLE; j++){
+        keys[j] = (j + 1) * 0xd6e8feb86659fd93ull;
+        if(j % 2 == 0){
+            b.insert(&keys[j], 8);
+        }
+    }
+    double best = INFINITY;
+    for(int round = 0; round < 4; round++){
+        auto start = chrono::steady_clock::now();
+        for(size_t j = 0; j < TUNE_SAMPLE; j++){
+            b.find(&keys[j], 8);
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / TUNE_SAMPLE;
+        //the first round warms up the caches and the branch predictors
+        if(round > 0){
+            best = min(best, ns);
+        }
+    }
+    return best;
+}
+
+//The candidate tuneFilter picks out of some candidates: the fastest one measured if calibrate,
+//otherwise the smallest (lowest rate if the memory is fixed), with fewer hash functions
+//breaking ties. Returns -1 if none of them can be picked.
+static int pick(const TuneGoal& goal, const vector<TuneChoice>& candidates, bool onlyMeeting){
+    int best = -1;
+    for(size_t i = 0; i < candidates.size(); i++){
+        const TuneChoice& c = candidates[i];
+        if((onlyMeeting && !c.meetsGoal) || (goal.calibrate && c.lookupNs == 0)){
+            continue;
+        }
+        if(best < 0){
+            best = i;
+            continue;
+        }
+        const TuneChoice& b = candidates[best];
+        bool better;
+        if(goal.calibrate){
+            better = c.lookupNs < b.lookupNs;
+        }else if(goal.fpr > 0){
+            better = c.size < b.size || (c.size == b.size && c.numHash < b.numHash);
+        }else{
+            better = c.fpr < b.fpr;
+        }
+        if(better){
+            best = i;
+        }
+    }
+    return best;
+}
+
+TuneResult tuneFilter(TuneGoal goal){
+    TuneResult result;
+    result.ok = false;
+    result.elements = goal.elements;
+    memset(&result.best, 0, sizeof(result.best));
+    if(goal.maxLookupNs > 0){
+        goal.calibrate = true;
+    }
+    if(goal.fpr <= 0 && goal.maxBytes == 0){
+        return result;
+    }
+    addCandidates(goal, BLOOM_CLASSIC, result.candidates);
+    addCandidates(goal, BLOOM_BLOCKED, result.candidates);
+    if(goal.calibrate){
+        //candidates over the memory limit are never built
+        for(TuneChoice& c : result.candidates){
+            if(c.meetsGoal){
+                c.lookupNs = timeLookups(c, goal.elements);
+                c.meetsGoal = goal.maxLookupNs == 0 || c.lookupNs <= goal.maxLookupNs;
+            }
+        }
+    }
+    int best = pick(goal, result.candidates, true);
+    result.ok = best >= 0;
+    if(best < 0){
+        best = pick(goal, result.candidates, false);
+    }
+    if(best < 0){
+        //calibrating and nothing fit in the memory limit
+        goal.calibrate = false;
+        best = pick(goal, result.candidates, false);
+    }
+    if(best >= 0){
+        result.best = result.candidates[best];
+    }
+    return result;
+}
+
+BloomFilter* makeTuned(const TuneResult& tune, bool concurrent, uint64_t seed){
+    BloomFilter* b = new BloomFilter(tune.best.size, tune.best.numHash, seed, tune.best.layout, concurrent);
+    b->numElem = tune.elements;
+    return b;
+}
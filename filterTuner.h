@@ -0,0 +1,61 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <vector>
+#include "bloomFilter.h"
+
+//Picks a bloom filter's size, number of hash functions and layout for a goal, instead of
+//tuning c and d by hand.
+//Size and k are worked out from BloomFilter::expectedFpr: for every k the smallest size which
+//meets the false positive rate is found by bisection, for both layouts. The blocked layout needs
+//more memory for the same rate (a lot more below 0.0001) but a lookup touches one cache line
+//instead of k.
+//Which one is faster depends on the machine and on whether the filter fits in its caches, so
+//with calibrate on each candidate is built at its real size and timed for a few milliseconds
+//of lookups on this machine.
+
+//What the filter has to do.
+//Any of fpr, maxBytes and maxLookupNs can be 0 for no limit, but at least one of fpr and
+//maxBytes has to be given.
+struct TuneGoal {
+    TuneGoal(unsigned long long elements); //constructor, every limit starts as 0
+    unsigned long long elements; //expected number of elements
+    double fpr; //highest false positive rate allowed once the filter holds every element
+    unsigned long long maxBytes; //most memory the bit array may take
+    //most time one lookup may take on average, in ns. It can only be checked by measuring,
+    //so setting it turns calibrate on.
+    double maxLookupNs;
+    //time lookups of every candidate on this machine and pick the fastest one which meets the
+    //goal, instead of the one using the least memory
+    bool calibrate;
+};
+
+//One filter the tuner looked at.
+struct TuneChoice {
+    BloomLayout layout; //bit layout
+    unsigned long long size; //bits
+    unsigned int numHash; //number of hash functions
+    double fpr; //expected false positive rate once it holds every element
+    double lookupNs; //measured time of one lookup in ns, 0 if it wasn't measured
+    bool meetsGoal; //true if it meets every limit of the goal
+    unsigned long long bytes(); //memory the bit array takes
+};
+
+//What the tuner picked.
+struct TuneResult {
+    bool ok; //false if no candidate meets the goal; best is then the closest one
+    unsigned long long elements; //expected number of elements, from the goal
+    TuneChoice best; //the filter to make
+    vector<TuneChoice> candidates; //every filter the tuner looked at, best included
+};
+
+//Works out the candidates for goal and picks one.
+//Without calibration the candidate with the least memory wins (or the lowest false positive
+//rate, if only memory is limited). With it, the fastest one which meets the goal wins.
+//Calibration builds every candidate, so it takes about as long as filling each one's bit array.
+TuneResult tuneFilter(TuneGoal goal);
+
+//Makes an empty filter with the size, hash functions and layout tune picked.
+BloomFilter* makeTuned(const TuneResult& tune, bool concurrent = false, uint64_t seed = DEFAULT_SEED);
+
+#endif
@@ -0,0 +1,265 @@
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "fuseFilter.h"
+
+using namespace std;
+
+//How many seeds building tries before giving up. Each try works with probability
+//well over 1/2 once duplicates are removed, so running out means something is wrong.
+const int FUSE_MAX_TRIES = 100;
+
+//Scrambles a 64 bit number (the murmur3 finalizer), used to make a new key hash for each
+//seed tried without hashing the key strings again.
+static inline uint64_t fuseMix(uint64_t h){
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+//Seeds for each try come from a splitmix64 sequence.
+static inline uint64_t nextSeed(uint64_t& state){
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+//Fingerprint of a key hash, cut down to the fingerprint size when it is stored.
+static inline uint64_t fingerprint(uint64_t hash){
+    return hash ^ (hash >> 32);
+}
+
+//Constructors.
+//Picks the segment length and the array length from the number of keys as in the paper:
+//segments get longer as the set grows, and the array needs relatively fewer extra slots.
+BinaryFuseFilter::BinaryFuseFilter(const string_view* keys, size_t n, int bits, uint64_t seed){
+    this->bits = bits == 16 ? 16 : 8;
+    this->seed = seed;
+    init(keys, n);
+}
+
+BinaryFuseFilter::BinaryFuseFilter(const vector<string>& keys, int bits, uint64_t seed){
+    this->bits = bits == 16 ? 16 : 8;
+    this->seed = seed;
+    vector<string_view> views(keys.begin(), keys.end());
+    init(views.data(), views.size());
+}
+
+void BinaryFuseFilter::init(const string_view* keys, size_t n){
+    //hashing every key once; duplicate keys would never fit, so they are dropped here
+    vector<uint64_t> hashes(n);
+    for(size_t i = 0; i < n; i++){
+        hashes[i] = keyHash(keys[i]);
+    }
+    sort(hashes.begin(), hashes.end());
+    hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+    numKeys = hashes.size();
+
+    uint32_t size = numKeys;
+    segmentLength = size == 0 ? 4 : uint32_t(1) << int(floor(log(size) / log(3.33) + 2.25));
+    if(segmentLength > 262144){
+        segmentLength = 262144;
+    }
+    segmentLengthMask = segmentLength - 1;
+    double sizeFactor = size <= 1 ? 0 : max(1.125, 0.875 + 0.25 * log(1000000.0) / log(size));
+    uint32_t capacity = size <= 1 ? 0 : uint32_t(round(size * sizeFactor));
+    uint32_t initSegmentCount = (capacity + segmentLength - 1) / segmentLength;
+    segmentCount = initSegmentCount > 2 ? initSegmentCount - 2 : 1;
+    arrayLength = (segmentCount + 2) * segmentLength;
+    segmentCountLength = segmentCount * segmentLength;
+    fingerprints = new uint8_t[(unsigned long long) arrayLength * (this->bits / 8)]();
+    ok = populate(hashes);
+}
+
+//binary fuse filter destructor.
+BinaryFuseFilter::~BinaryFuseFilter(){
+    delete[] fingerprints;
+}
+
+//hashes a string once with the filter's seed. The build's seed is mixed in afterwards.
+uint64_t BinaryFuseFilter::keyHash(string_view element){
+    return hashKey(element.data(), element.size(), seed);
+}
+
+//The 3 slots of a key.
+//The first is in one of the segmentCount segments (picked by multiply and shift), the second
+//and third are in the next two segments, at an offset within the segment taken from other
+//bits of the hash.
+inline uint32_t BinaryFuseFilter::slot(uint64_t hash, int index){
+    uint64_t h = (uint64_t) (((unsigned __int128) hash * segmentCountLength) >> 64);
+    h += index * segmentLength;
+    uint64_t low = hash & ((uint64_t(1) << 36) - 1);
+    h ^= (low >> (36 - 18 * index)) & segmentLengthMask;
+    return h;
+}
+
+//Fills the fingerprints ("peeling", from the paper).
+//Every slot keeps a count of the keys which use it, the xor of their hashes, and which of
+//their 3 slots it is for them. A slot used by a single key gives that key away: the key is
+//taken out of its other 2 slots and pushed on a stack, which can free up more slots.
+//If every key gets peeled, going through the stack backwards and setting each key's own slot
+//to its fingerprint xor its other two slots makes all of them match.
+//If some keys are left in a cycle, the hashes are redone with another seed.
+bool BinaryFuseFilter::populate(vector<uint64_t>& hashes){
+    uint32_t size = hashes.size();
+    uint32_t capacity = arrayLength;
+    //the count of a slot is in the high 6 bits of t2count and which slot it is in the low 2
+    vector<uint8_t> t2count(capacity);
+    vector<uint64_t> t2hash(capacity);
+    vector<uint32_t> alone(capacity);
+    //keys hashed with the current seed and sorted by segment, then the stack of peeled keys
+    vector<uint64_t> reverseOrder(size + 1);
+    vector<uint8_t> reverseH(size);
+    //sorting the keys into blocks by their first segment means the slots are filled in
+    //order through the array, which is much friendlier to the cache for big sets
+    int blockBits = 1;
+    while((uint32_t(1) << blockBits) < segmentCount){
+        blockBits++;
+    }
+    uint32_t block = uint32_t(1) << blockBits;
+    vector<uint32_t> startPos(block);
+    uint64_t state = seed;
+    uint32_t h012[5];
+    for(int tries = 0; tries < FUSE_MAX_TRIES; tries++){
+        fuseSeed = nextSeed(state);
+        fill(reverseOrder.begin(), reverseOrder.end(), 0);
+        //marks the end so the search for a free place in the last block stops
+        reverseOrder[size] = 1;
+        fill(t2count.begin(), t2count.end(), 0);
+        fill(t2hash.begin(), t2hash.end(), 0);
+        for(uint32_t i = 0; i < block; i++){
+            startPos[i] = ((uint64_t) i * size) >> blockBits;
+        }
+        for(uint32_t i = 0; i < size; i++){
+            uint64_t hash = fuseMix(hashes[i] + fuseSeed);
+            uint32_t segment = hash >> (64 - blockBits);
+            while(reverseOrder[startPos[segment]] != 0){
+                segment = (segment + 1) & (block - 1);
+            }
+            reverseOrder[startPos[segment]] = hash;
+            startPos[segment]++;
+        }
+        //adding every key to its 3 slots
+        bool overflow = false;
+        for(uint32_t i = 0; i < size; i++){
+            uint64_t hash = reverseOrder[i];
+            for(int j = 0; j < 3; j++){
+                uint32_t h = slot(hash, j);
+                t2count[h] += 4;
+                t2count[h] ^= j;
+                t2hash[h] ^= hash;
+                //more than 63 keys in one slot doesn't fit in the count
+                overflow |= t2count[h] < 4;
+            }
+        }
+        if(overflow){
+            continue;
+        }
+        //peeling
+        uint32_t queue = 0;
+        for(uint32_t i = 0; i < capacity; i++){
+            alone[queue] = i;
+            queue += (t2count[i] >> 2) == 1;
+        }
+        uint32_t stack = 0;
+        while(queue > 0){
+            queue--;
+            uint32_t index = alone[queue];
+            if((t2count[index] >> 2) != 1){
+                continue;
+            }
+            uint64_t hash = t2hash[index];
+            uint8_t found = t2count[index] & 3;
+            h012[0] = slot(hash, 0);
+            h012[1] = slot(hash, 1);
+            h012[2] = slot(hash, 2);
+            h012[3] = h012[0];
+            h012[4] = h012[1];
+            reverseH[stack] = found;
+            reverseOrder[stack] = hash;
+            stack++;
+            for(int j = 1; j <= 2; j++){
+                uint32_t other = h012[found + j];
+                alone[queue] = other;
+                queue += (t2count[other] >> 2) == 2;
+                t2count[other] -= 4;
+                t2count[other] ^= (found + j) % 3;
+                t2hash[other] ^= hash;
+            }
+        }
+        if(stack < size){
+            continue;
+        }
+        //assigning the fingerprints, last peeled first
+        for(uint32_t i = size; i-- > 0;){
+            uint64_t hash = reverseOrder[i];
+            h012[0] = slot(hash, 0);
+            h012[1] = slot(hash, 1);
+            h012[2] = slot(hash, 2);
+            h012[3] = h012[0];
+            h012[4] = h012[1];
+            uint32_t own = h012[reverseH[i]];
+            uint32_t a = h012[reverseH[i] + 1];
+            uint32_t b = h012[reverseH[i] + 2];
+            if(bits == 8){
+                fingerprints[own] = uint8_t(fingerprint(hash)) ^ fingerprints[a] ^ fingerprints[b];
+            }else{
+                uint16_t* f = (uint16_t*) fingerprints;
+                f[own] = uint16_t(fingerprint(hash)) ^ f[a] ^ f[b];
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+//checks if an element is in the set.
+//A filter which couldn't be built says every element is in it, so it never gives a false negative.
+bool BinaryFuseFilter::find(string_view element){
+    if(!ok){
+        return true;
+    }
+    if(numKeys == 0){
+        return false;
+    }
+    uint64_t hash = fuseMix(keyHash(element) + fuseSeed);
+    uint32_t h0 = slot(hash, 0);
+    uint32_t h1 = slot(hash, 1);
+    uint32_t h2 = slot(hash, 2);
+    if(bits == 8){
+        return uint8_t(fingerprint(hash)) == (fingerprints[h0] ^ fingerprints[h1] ^ fingerprints[h2]);
+    }
+    const uint16_t* f = (const uint16_t*) fingerprints;
+    return uint16_t(fingerprint(hash)) == (f[h0] ^ f[h1] ^ f[h2]);
+}
+
+//Version of find for keys given as raw bytes.
+bool BinaryFuseFilter::find(const void* key, size_t len){
+    return find(string_view((const char*) key, len));
+}
+
+//bytes of fingerprints
+unsigned long long BinaryFuseFilter::bytes(){
+    return (unsigned long long) arrayLength * (bits / 8);
+}
+
+//bits of fingerprints per different key in the set
+double BinaryFuseFilter::bitsPerKey(){
+    return numKeys == 0 ? 0 : 8.0 * bytes() / numKeys;
+}
+
+//prints out the fingerprints
+//used for testing
+void BinaryFuseFilter::print(){
+    for(uint32_t i = 0; i < arrayLength; i++){
+        cout << i << "," << (bits == 8 ? fingerprints[i] : ((uint16_t*) fingerprints)[i]) << " ";
+        if(i%10 == 0){
+            cout << endl;
+        }
+    }
+}
@@ -0,0 +1,529 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include "bloomFilter.h"
+#include "bulkLoad.h"
+#include "fuseFilter.h"
+#include "compressedFilter.h"
+#include "filterTuner.h"
+#include "filterServer.h"
+
+//Command line driver for the bloom filter.
+//Build with: g++ -std=c++17 -O2 -pthread bloomFilter.cpp bulkLoad.cpp fuseFilter.cpp compressedFilter.cpp filterTuner.cpp filterServer.cpp main.cpp -o bloomFilter
+//./bloomFilter setup.txt input.txt successfulSearch.txt failedSearch.txt remove.txt
+//    runs the 10 phase experiment on the assignment's files.
+//./bloomFilter build setup.txt input.txt out.bloom [threads]
+//    builds a filter from every line of input.txt with a thread per core (or threads threads)
+//    and saves it.
+//./bloomFilter fuse input.txt successfulSearch.txt failedSearch.txt [bits]
+//    builds a binary fuse filter with bits bit fingerprints (8 or 16, default 8) from
+//    every line of input.txt and checks the searches against it.
+//./bloomFilter stream filter.bloom [-v]
+//./bloomFilter stream setup.txt input.txt [-v]
+//    opens a saved filter (or builds one from input.txt), then copies every line of stdin
+//    which is in the filter to stdout. With -v the lines which aren't in it are copied instead.
+//./bloomFilter pack filter.bloom filter.gcs
+//./bloomFilter unpack filter.gcs filter.bloom
+//    converts a saved filter to the compressed format for sending to another machine, and back.
+//./bloomFilter tune elements fpr [maxBytes [maxLookupNs]] [-c]
+//    prints the size, hash functions and layout to use for elements keys, and the other
+//    candidates. 0 is no limit. With -c (or a lookup time limit) the candidates are timed.
+//./bloomFilter serve socket name=filter.bloom [name=filter.bloom ...]
+//./bloomFilter serve tcp:port name=filter.bloom [name=filter.bloom ...]
+//    opens saved filters and serves them to other processes (see filterServer.h) until
+//    killed. Inserts and removes change only the served copy, never the files.
+//Speed measurements are in benchmark.cpp.
+
+using namespace std;
+
+//Reads p, m, c and d from a setup file, one per line.
+//Returns false if the file can't be opened.
+bool readSetup(const char* path, double& p, int& m, float& c, float& d){
+    vector<string> a;
+    string temp;
+    ifstream f;
+    f.open(path);
+    if(!f.is_open()){
+        return false;
+    }
+    while(getline(f,temp)){
+        a.push_back(temp);
+    }
+    p = stod(a[0]);
+    m = stoi(a[1]);
+    c = stof(a[2]);
+    d = stof(a[3]);
+    f.close();
+    return true;
+}
+
+//Builds a filter from every line of a key file and saves it so later runs can open it
+//instead of building it again. The lines are inserted in parallel by bulkLoad.
+//Run with: ./bloomFilter build setup.txt input.txt out.bloom [threads]
+int buildFilter(const char* setup, const char* input, const char* out, int threads){
+    double p;
+    int m;
+    float c;
+    float d;
+    if(!readSetup(setup, p, m, c, d)){
+        cout << "Could not open " << setup << endl;
+        return 1;
+    }
+    BloomFilter b(p, m, c, d);
+    BulkLoadResult loaded = bulkLoad(b, input, threads);
+    if(!loaded.ok){
+        cout << "Could not read " << input << endl;
+        return 1;
+    }
+    cout << "Inserted " << loaded.keys << " keys in " << loaded.seconds << " s ("
+         << loaded.keys / max(loaded.seconds, 1e-9) / 1e6 << " million keys/s)" << endl;
+    if(!b.save(out)){
+        cout << "Could not write " << out << endl;
+        return 1;
+    }
+    cout << "Saved filter of " << b.size << " bits with " << b.numHash << " hash functions to " << out << endl;
+    return 0;
+}
+
+//Reads every line of a file. Returns false if the file can't be opened.
+bool readLines(const char* path, vector<string>& lines){
+    ifstream f;
+    f.open(path);
+    if(!f.is_open()){
+        return false;
+    }
+    string temp;
+    while(getline(f,temp)){
+        lines.push_back(temp);
+    }
+    f.close();
+    return true;
+}
+
+//Builds a binary fuse filter from every line of a key file and checks every line of the
+//successful and failed search files against it. The input never changes after it is read,
+//so the static filter gives the same answers as a bloom filter with less memory.
+//Run with: ./bloomFilter fuse input.txt successfulSearch.txt failedSearch.txt [bits]
+int fuseExperiment(const char* input, const char* succ, const char* fail, int bits){
+    vector<string> keys;
+    vector<string> present;
+    vector<string> missing;
+    if(!readLines(input, keys) || !readLines(succ, present) || !readLines(fail, missing)){
+        cout << "Could not read the input or search files" << endl;
+        return 1;
+    }
+    BinaryFuseFilter f(keys, bits);
+    if(!f.ok){
+        cout << "Could not build the filter" << endl;
+        return 1;
+    }
+    int countN = 0;
+    int countF = 0;
+    for(const string& key : present){
+        countN += !f.find(key);
+    }
+    for(const string& key : missing){
+        countF += f.find(key);
+    }
+    double rate = missing.empty() ? 0 : double(countF) / missing.size();
+    cout << "Binary fuse filter of " << f.numKeys << " keys with " << f.bits << " bit fingerprints" << endl;
+    cout << "Number of false negatives: " << endl;
+    cout << countN << endl;
+    cout << "Number of false positives: " << endl;
+    cout << countF << endl;
+    cout << "Probability of false positives: " << endl;
+    cout << rate << endl;
+    //a bloom filter for the same false positive rate as the fingerprints give
+    double p = pow(2.0, -f.bits);
+    cout << "Bits per key: " << f.bitsPerKey() << " (a bloom filter with p = " << p << " needs "
+         << double(BloomFilter::BloomFilterSize(p, f.numKeys, 1.0)) / max(f.numKeys, 1ull) << ")" << endl;
+    return 0;
+}
+
+//Stream mode buffers.
+//stdin is read STREAM_CHUNK bytes at a time, keys are looked up STREAM_BATCH at a time
+//with findMany, and stdout is written once there is a STREAM_CHUNK of output, so a big
+//stream takes two syscalls per megabyte.
+const size_t STREAM_CHUNK = 1 << 20;
+const size_t STREAM_BATCH = 4096;
+
+//Writes all of len bytes to fd. Returns false if the write fails (e.g. the reader is gone).
+static bool writeAll(int fd, const char* buf, size_t len){
+    while(len > 0){
+        ssize_t n = write(fd, buf, len);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+//Copies the lines of stdin which are in the filter to stdout, or the lines which aren't
+//if invert is true, like grep -v.
+//Only whole lines are looked up: the part of a chunk after its last newline is moved to the
+//front of the buffer and finished by the next read. A line longer than the buffer makes it grow.
+int streamFilter(BloomFilter& b, bool invert){
+    vector<char> in(STREAM_CHUNK);
+    vector<char> out;
+    out.reserve(2 * STREAM_CHUNK);
+    vector<string_view> keys;
+    keys.reserve(STREAM_BATCH);
+    vector<uint64_t> found(STREAM_BATCH / 64);
+    size_t have = 0;
+    bool eof = false;
+    while(!eof){
+        ssize_t n = read(0, in.data() + have, in.size() - have);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            cerr << "Could not read stdin: " << strerror(errno) << endl;
+            return 1;
+        }
+        eof = n == 0;
+        have += n;
+        //at the end of the input the last line doesn't need a newline
+        size_t end = have;
+        if(!eof){
+            const char* last = (const char*) memrchr(in.data(), '\n', have);
+            if(last == NULL){
+                if(have == in.size()){
+                    in.resize(in.size() * 2);
+                }
+                continue;
+            }
+            end = last - in.data() + 1;
+        }
+        const char* p = in.data();
+        const char* stop = in.data() + end;
+        while(p < stop){
+            keys.clear();
+            while(keys.size() < STREAM_BATCH && p < stop){
+                const char* newline = (const char*) memchr(p, '\n', stop - p);
+                const char* lineEnd = newline != NULL ? newline : stop;
+                keys.push_back(string_view(p, lineEnd - p));
+                p = lineEnd + 1;
+            }
+            b.findMany(keys.data(), keys.size(), found.data());
+            for(size_t j = 0; j < keys.size(); j++){
+                if((((found[j / 64] >> (j % 64)) & 1) != 0) != invert){
+                    out.insert(out.end(), keys[j].begin(), keys[j].end());
+                    out.push_back('\n');
+                }
+            }
+        }
+        memmove(in.data(), in.data() + end, have - end);
+        have -= end;
+        if(out.size() >= STREAM_CHUNK || eof){
+            if(!writeAll(1, out.data(), out.size())){
+                return 1;
+            }
+            out.clear();
+        }
+    }
+    return 0;
+}
+
+//Stream mode: opens or builds the filter, then streams stdin through it.
+//Run with: ./bloomFilter stream filter.bloom [-v]
+//      or: ./bloomFilter stream setup.txt input.txt [-v]
+int streamMode(int argc, char* argv[]){
+    vector<string> args;
+    bool invert = false;
+    for(int i = 2; i < argc; i++){
+        if(string(argv[i]) == "-v"){
+            invert = true;
+        }else{
+            args.push_back(argv[i]);
+        }
+    }
+    if(args.size() == 1){
+        BloomFilter* b = BloomFilter::open(args[0].c_str());
+        if(b == NULL){
+            cerr << "Could not open filter " << args[0] << endl;
+            return 1;
+        }
+        int status = streamFilter(*b, invert);
+        delete b;
+        return status;
+    }
+    if(args.size() == 2){
+        double p;
+        int m;
+        float c;
+        float d;
+        if(!readSetup(args[0].c_str(), p, m, c, d)){
+            cerr << "Could not open " << args[0] << endl;
+            return 1;
+        }
+        BloomFilter b(p, m, c, d);
+        if(!bulkLoad(b, args[1].c_str()).ok){
+            cerr << "Could not read " << args[1] << endl;
+            return 1;
+        }
+        return streamFilter(b, invert);
+    }
+    cerr << "Usage: ./bloomFilter stream filter.bloom [-v]" << endl;
+    cerr << "       ./bloomFilter stream setup.txt input.txt [-v]" << endl;
+    return 1;
+}
+
+//Converts a saved filter to the compressed format (pack) or a compressed filter back to a
+//saved filter (unpack).
+//Run with: ./bloomFilter pack filter.bloom filter.gcs
+//      or: ./bloomFilter unpack filter.gcs filter.bloom
+int packFilter(const char* in, const char* out, bool pack){
+    BloomFilter* b;
+    if(pack){
+        b = BloomFilter::open(in, true);
+    }else{
+        ifstream f(in, ios::binary);
+        b = f.is_open() ? importCompressed(f) : NULL;
+    }
+    if(b == NULL){
+        cout << "Could not open filter " << in << endl;
+        return 1;
+    }
+    bool ok;
+    if(pack){
+        ofstream f(out, ios::binary | ios::trunc);
+        ok = f.is_open() && exportCompressed(*b, f);
+        f.close();
+        ok = ok && !f.fail();
+    }else{
+        ok = b->save(out);
+    }
+    if(!ok){
+        cout << "Could not write " << out << endl;
+        delete b;
+        return 1;
+    }
+    unsigned long long raw = BLOOM_DATA_OFFSET + b->bt->nwords * 8;
+    unsigned long long packed = compressedSize(*b);
+    cout << (pack ? "Packed " : "Unpacked ") << b->size << " bits: " << raw << " bytes as a filter file, " << packed
+         << " bytes compressed (" << 8.0 * packed / max(b->estimateCount(), 1.0) << " bits per key)" << endl;
+    delete b;
+    return 0;
+}
+
+//Tune mode: prints what tuneFilter picks for a goal and every candidate it looked at.
+//Run with: ./bloomFilter tune elements fpr [maxBytes [maxLookupNs]] [-c]
+int tuneMode(int argc, char* argv[]){
+    vector<string> args;
+    bool calibrate = false;
+    for(int i = 2; i < argc; i++){
+        if(string(argv[i]) == "-c"){
+            calibrate = true;
+        }else{
+            args.push_back(argv[i]);
+        }
+    }
+    if(args.size() < 2 || args.size() > 4){
+        cerr << "Usage: ./bloomFilter tune elements fpr [maxBytes [maxLookupNs]] [-c]" << endl;
+        return 1;
+    }
+    TuneGoal goal(stoull(args[0]));
+    goal.fpr = stod(args[1]);
+    goal.maxBytes = args.size() > 2 ? stoull(args[2]) : 0;
+    goal.maxLookupNs = args.size() > 3 ? stod(args[3]) : 0;
+    goal.calibrate = calibrate;
+    TuneResult r = tuneFilter(goal);
+    if(r.candidates.empty()){
+        cerr << "Give a false positive rate or a memory limit" << endl;
+        return 1;
+    }
+    for(TuneChoice& c : r.candidates){
+        cout << (c.layout == BLOOM_BLOCKED ? "blocked" : "classic") << " k = " << c.numHash << ": " << c.size
+             << " bits (" << double(c.size) / goal.elements << " per key), fpr " << c.fpr;
+        if(c.lookupNs > 0){
+            cout << ", " << c.lookupNs << " ns per lookup";
+        }
+        cout << (c.meetsGoal ? "" : ", misses the goal") << endl;
+    }
+    cout << (r.ok ? "Best: " : "Nothing meets the goal, closest: ")
+         << (r.best.layout == BLOOM_BLOCKED ? "blocked" : "classic") << " k = " << r.best.numHash << ", "
+         << r.best.size << " bits (" << r.best.bytes() << " bytes)" << endl;
+    return r.ok ? 0 : 2;
+}
+
+//server stopped by SIGINT and SIGTERM
+static FilterServer* signalServer = NULL;
+
+static void stopServer(int){
+    signalServer->stop();
+}
+
+//Serve mode: opens each name=path filter and serves them until SIGINT or SIGTERM.
+//Run with: ./bloomFilter serve socket name=filter.bloom [name=filter.bloom ...]
+//      or: ./bloomFilter serve tcp:port name=filter.bloom [name=filter.bloom ...]
+int serveMode(int argc, char* argv[]){
+    if(argc < 4){
+        cerr << "Usage: ./bloomFilter serve socket|tcp:port name=filter.bloom [name=filter.bloom ...]" << endl;
+        return 1;
+    }
+    FilterServer server;
+    for(int i = 3; i < argc; i++){
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if(eq == string::npos || eq == 0){
+            cerr << "Filters are given as name=filter.bloom, not " << arg << endl;
+            return 1;
+        }
+        BloomFilter* b = BloomFilter::open(arg.c_str() + eq + 1);
+        if(b == NULL){
+            cerr << "Could not open filter " << arg.substr(eq + 1) << endl;
+            return 1;
+        }
+        server.addFilter(arg.substr(0, eq), b);
+    }
+    string where = argv[2];
+    bool ok = where.compare(0, 4, "tcp:") == 0 ? server.listenTcp(stoi(where.substr(4))) : server.listenUnix(where.c_str());
+    if(!ok){
+        cerr << "Could not listen on " << where << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    signalServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cerr << "Serving " << server.filters.size() << " filter(s) on " << where << endl;
+    ok = server.run();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if(!ok){
+        cerr << "Server failed: " << strerror(errno) << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    if(argc > 1 && string(argv[1]) == "stream"){
+        return streamMode(argc, argv);
+    }
+    if(argc > 4 && string(argv[1]) == "build"){
+        return buildFilter(argv[2], argv[3], argv[4], argc > 5 ? stoi(argv[5]) : 0);
+    }
+    if(argc > 4 && string(argv[1]) == "fuse"){
+        return fuseExperiment(argv[2], argv[3], argv[4], argc > 5 ? stoi(argv[5]) : 8);
+    }
+    if(argc > 3 && (string(argv[1]) == "pack" || string(argv[1]) == "unpack")){
+        return packFilter(argv[2], argv[3], string(argv[1]) == "pack");
+    }
+    if(argc > 1 && string(argv[1]) == "tune"){
+        return tuneMode(argc, argv);
+    }
+    if(argc > 1 && string(argv[1]) == "serve"){
+        return serveMode(argc, argv);
+    }
+
+
+    string temp;
+    double p;
+    int m;
+    float c;
+    float d;
+    
+    //Parsing setup.txt
+    readSetup(argv[1], p, m, c, d);
+    BloomFilter b = BloomFilter(p,m,c,d);
+    cout << "Experiment for values of: " << endl;
+    cout << "p = " << p << endl;
+    cout << "c = " <<  c <<endl;
+    cout << "d = " << d << endl;
+    cout << "q = " << b.q << endl;
+    ifstream fa;
+    fa.open(argv[4]);
+    ifstream in;
+    in.open(argv[2]);
+    ifstream s;
+    s.open(argv[3]);
+    ifstream r;
+    r.open(argv[5]);
+    double countF = 0;
+    double countN = 0;
+    double countFTotal = 0;
+    double countNTotal = 0;
+    vector<string> falseNeg;
+    vector<string> falseNegTotal;
+    for(int i =0; i < 10; i++){
+        countN = 0;
+        countF = 0;
+        falseNeg.clear();
+        //Parsing input.txt
+        if(in.is_open()){
+            for(int i = 0; i < 1000; i++){
+                getline(in,temp);
+                b.insert(temp);
+            }
+        }
+        //parsing successfulSearch.txt
+        if(s.is_open()){
+            for(int i = 0; i < 100; i++){
+                getline(s,temp);
+                bool x = b.find(temp);
+               if(x == false){
+                    countN++;
+                    countNTotal++;
+                }
+            }
+        }
+
+        
+        //parsing failedSearch.txt
+        if(fa.is_open()){
+            for(int i = 0; i < 100; i++){
+                getline(fa,temp);
+                bool x = b.find(temp);
+                if(x == true){
+                    countF++;
+                    countFTotal++;
+                    falseNeg.push_back(temp);
+                    falseNegTotal.push_back(temp);
+                }
+            }
+        }
+        
+        //parsing remove.txt
+        if(r.is_open()){
+            for(int i = 0; i < 100; i++){
+                getline(r,temp);
+                b.remove(temp);
+            }
+            
+        }
+        cout << "Phase " << i+1 << endl;
+        cout << "Number of false negatives: " << endl;
+        cout << countN << endl;
+        cout << "Number of false positives: " << endl;
+        cout << countF << endl;
+        cout << "Probability of false positives: " << endl;
+        cout << countF/100 << endl;
+        cout << "False Positive Elements: " << endl;
+        for(int i = 0; i < countF; i++){
+            cout << falseNeg[i] << " " << i+1 << endl;
+        }
+    }
+    r.close();
+    s.close();
+    fa.close();
+
+    cout << "Number of false negatives: " << endl;
+    cout << countNTotal << endl;
+    cout << "Number of false positives: " << endl;
+    cout << countFTotal << endl;
+    cout << "Probability of false positives: " << endl;
+    cout << countFTotal/1000 << endl;
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <math.h>
+#include "scalableFilter.h"
+
+using namespace std;
+
+//Constructor for the scalable bloom filter.
+//Makes the first filter right away.
+ScalableBloomFilter::ScalableBloomFilter(double p, int m, int s, double r, BloomLayout layout, uint64_t seed){
+    this->p = p;
+    this->m = m > 0 ? m : 1;
+    this->s = s > 1 ? s : 2;
+    this->r = r;
+    this->layout = layout;
+    count = 0;
+    this->seed = seed;
+    addFilter();
+}
+
+//scalable bloom filter destructor.
+ScalableBloomFilter::~ScalableBloomFilter(){
+    for(BloomFilter* f : filters){
+        delete f;
+    }
+}
+
+//adds a new filter.
+//Filter i has capacity m * s^i and false positive rate p * (1 - r) * r^i, so the
+//rates add up to at most p. Its size and number of hash functions come from the same
+//equations BloomFilter uses, and each filter gets its own seed.
+//A lookup of a missing key is a false positive when all k of its bits are 1, which happens
+//with chance fill^k, so the filter is full once fill^k reaches its rate. That is at a fill
+//of about one half, but working it out from k keeps the bound when k was rounded down.
+void ScalableBloomFilter::addFilter(){
+    int i = filters.size();
+    double rate = p * (1 - r) * pow(r, i);
+    double capacity = m * pow(s, i);
+    int cap = capacity < INT32_MAX ? (int) capacity : INT32_MAX;
+    unsigned long long size = BloomFilter::BloomFilterSize(rate, cap, 1.0);
+    unsigned int numHash = BloomFilter::numHashFunctions(size, cap, 1.0);
+    uint64_t filterSeed = seed + (i + 1) * 0x9e3779b97f4a7c15ull;
+    filters.push_back(new BloomFilter(size, numHash, filterSeed, layout));
+    rates.push_back(rate);
+    fillLimits.push_back(pow(rate, 1.0 / filters.back()->numHash));
+    setBits.push_back(0);
+}
+
+//inserts a string.
+//The bits this insert changes from 0 to 1 are counted before BloomFilter::insertHashed sets
+//them, which keeps the fill ratio exact without having to count the whole array. A bit which
+//two of the key's probes land on is only counted once.
+void ScalableBloomFilter::insert(string_view element){
+    if(find(element)){
+        return;
+    }
+    BloomFilter* f = filters.back();
+    uint64_t elem = f->keyHash(element);
+    unsigned long long base = f->blockBase(elem);
+    for(unsigned int i = 0; i < f->numHash; i++){
+        unsigned long long index = f->probe(elem,i,base);
+        bool fresh = !f->bt->test(index);
+        for(unsigned int j = 0; fresh && j < i; j++){
+            fresh = f->probe(elem,j,base) != index;
+        }
+        setBits.back() += fresh;
+    }
+    f->insertHashed(element, elem);
+    count++;
+    if(fillRatio() >= fillLimits.back()){
+        addFilter();
+    }
+}
+
+//checks if an element is in any of the filters.
+//Newest first since the newest filter is the biggest and holds the most elements.
+bool ScalableBloomFilter::find(string_view element){
+    for(int i = filters.size() - 1; i >= 0; i--){
+        if(filters[i]->find(element)){
+            return true;
+        }
+    }
+    return false;
+}
+
+double ScalableBloomFilter::fillRatio(){
+    return double(setBits.back()) / filters.back()->size;
+}
+
+//The chance of a false positive is at most the sum of each filter's chance.
+double ScalableBloomFilter::falsePositiveBound(){
+    double total = 0;
+    for(double rate : rates){
+        total += rate;
+    }
+    return total;
+}
+
+unsigned long long ScalableBloomFilter::totalBits(){
+    unsigned long long total = 0;
+    for(BloomFilter* f : filters){
+        total += f->size;
+    }
+    return total;
+}
@@ -0,0 +1,48 @@
+#ifndef SCALABLE_H
+#define SCALABLE_H
+
+#include <vector>
+#include "bloomFilter.h"
+
+//Scalable bloom filter (Almeida, Baquero, Preguica and Hutchison, 2007).
+//A BloomFilter sized for m elements keeps filling past m and its false positive rate climbs
+//towards 1. This filter starts with one BloomFilter and, whenever the newest one becomes half
+//full, adds another which is s times bigger and has an r times smaller false positive rate.
+//Keys are only ever inserted into the newest filter and a lookup checks all of them, so
+//nothing is rehashed when it grows. With the first filter's rate set to P(1-r) the rates
+//form a geometric series, so the total false positive rate stays below P however many
+//elements are added.
+class ScalableBloomFilter {
+  public:
+    //constructor.
+    //p = bound on the false positive rate of the whole filter
+    //m = expected number of elements for the first filter, a guess is fine
+    //s = growth factor of each new filter's capacity
+    //r = tightening ratio of each new filter's false positive rate
+    //layout = bit layout of the filters
+    //seed = seed the filters' seeds are made from
+    ScalableBloomFilter(double p, int m, int s = 2, double r = 0.85, BloomLayout layout = BLOOM_CLASSIC,
+                        uint64_t seed = DEFAULT_SEED);
+    ~ScalableBloomFilter(); //destructor
+    void insert(string_view element); //inserts into the newest filter unless element is already in one
+    bool find(string_view element); //checks every filter for element
+    double fillRatio(); //fraction of the newest filter's bits which are 1
+    double falsePositiveBound(); //sum of the false positive rates of the filters made so far
+    unsigned long long totalBits(); //bits used by all of the filters
+    void addFilter(); //adds a new filter, used when the newest gets full
+
+    //Data
+    double p; //bound on the total false positive rate
+    int m; //capacity of the first filter
+    int s; //growth factor
+    double r; //tightening ratio
+    BloomLayout layout; //bit layout of the filters
+    uint64_t seed; //seed the filters' seeds are made from, each filter gets a different one
+    unsigned long long count; //number of elements inserted
+    vector<BloomFilter*> filters; //the filters, oldest first
+    vector<double> rates; //false positive rate each filter was made for
+    vector<double> fillLimits; //fill ratio of each filter at which a new filter is added
+    vector<unsigned long long> setBits; //number of bits set to 1 in each filter
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <sched.h>
+#include <dirent.h>
+#ifdef BLOOM_NUMA
+#include <numa.h>
+#endif
+#include "shardedFilter.h"
+
+using namespace std;
+
+//Parses a cpu list like "0-3,8,10-11" from sysfs.
+static vector<int> parseCpuList(const string& list){
+    vector<int> cpus;
+    size_t start = 0;
+    while(start < list.size()){
+        size_t comma = list.find(',', start);
+        string range = list.substr(start, comma == string::npos ? string::npos : comma - start);
+        size_t dash = range.find('-');
+        if(!range.empty() && isdigit(range[0])){
+            int first = stoi(range);
+            int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; cpu++){
+                cpus.push_back(cpu);
+            }
+        }
+        if(comma == string::npos){
+            break;
+        }
+        start = comma + 1;
+    }
+    return cpus;
+}
+
+//Reads /sys/devices/system/node/node<N>/cpulist for every node. Nodes without cpus (memory
+//only) are left out since no thread can run on them.
+NumaTopology NumaTopology::read(){
+    NumaTopology t;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if(dir != NULL){
+        vector<int> ids;
+        struct dirent* entry;
+        while((entry = readdir(dir)) != NULL){
+            if(strncmp(entry->d_name, "node", 4) == 0 && isdigit(entry->d_name[4])){
+                ids.push_back(atoi(entry->d_name + 4));
+            }
+        }
+        closedir(dir);
+        sort(ids.begin(), ids.end());
+        for(int id : ids){
+            ifstream f("/sys/devices/system/node/node" + to_string(id) + "/cpulist");
+            string list;
+            getline(f, list);
+            vector<int> cpus = parseCpuList(list);
+            if(!cpus.empty()){
+                t.nodeCpus.push_back(cpus);
+            }
+        }
+    }
+    if(t.nodeCpus.empty()){
+        vector<int> cpus;
+        for(unsigned int cpu = 0; cpu < max(thread::hardware_concurrency(), 1u); cpu++){
+            cpus.push_back(cpu);
+        }
+        t.nodeCpus.push_back(cpus);
+    }
+    return t;
+}
+
+int NumaTopology::nodes(){
+    return nodeCpus.size();
+}
+
+int NumaTopology::nodeOfCpu(int cpu){
+    for(size_t node = 0; node < nodeCpus.size(); node++){
+        if(find(nodeCpus[node].begin(), nodeCpus[node].end(), cpu) != nodeCpus[node].end()){
+            return node;
+        }
+    }
+    return 0;
+}
+
+int NumaTopology::currentNode(){
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : nodeOfCpu(cpu);
+}
+
+bool NumaTopology::pinToNode(int node){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : nodeCpus[node % nodes()]){
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+//Constructor for the sharded filter.
+//Every shard is made by a thread pinned to the shard's node. Big bit arrays are mapped lazily
+//(see BitArray), so the thread also writes every page once to fault it in on its own node;
+//with libnuma the memory is bound to the node instead and the pages are left to fault in
+//on first use.
+ShardedBloomFilter::ShardedBloomFilter(double p, int m, int shards, BloomLayout layout, bool concurrent, uint64_t seed){
+    topology = NumaTopology::read();
+#ifdef BLOOM_NUMA
+    bool libnuma = numa_available() >= 0;
+#endif
+    numShards = shards > 0 ? shards : topology.nodes();
+    this->seed = seed;
+    this->shards.resize(numShards);
+    shardNode.resize(numShards);
+    int perShard = max((m + numShards - 1) / numShards, 1);
+    vector<thread> makers;
+    for(int i = 0; i < numShards; i++){
+        shardNode[i] = i % topology.nodes();
+        makers.push_back(thread([&, i](){
+            topology.pinToNode(shardNode[i]);
+            BloomFilter* b = new BloomFilter(p, perShard, 1.0, 1.0, layout, concurrent, seed);
+            if(b->bt->mapping != NULL){
+#ifdef BLOOM_NUMA
+                if(libnuma){
+                    numa_tonode_memory(b->bt->mapping, b->bt->mappingLen, shardNode[i]);
+                }else{
+                    memset(b->bt->words, 0, b->bt->nwords * 8);
+                }
+#else
+                memset(b->bt->words, 0, b->bt->nwords * 8);
+#endif
+            }
+            this->shards[i] = b;
+        }));
+    }
+    for(thread& t : makers){
+        t.join();
+    }
+}
+
+//sharded filter destructor.
+ShardedBloomFilter::~ShardedBloomFilter(){
+    for(BloomFilter* b : shards){
+        delete b;
+    }
+}
+
+//The shard comes from the key hash scrambled again, so it doesn't depend on the bits of
+//the hash the shard itself uses to pick bits and blocks.
+int ShardedBloomFilter::shardOf(uint64_t elem){
+    elem ^= elem >> 32;
+    elem *= 0xd6e8feb86659fd93ull;
+    elem ^= elem >> 32;
+    return reduceRange(elem, numShards);
+}
+
+int ShardedBloomFilter::nodeOf(string_view element){
+    return shardNode[shardOf(hashKey(element.data(), element.size(), seed))];
+}
+
+//Every shard has the same seed, so the key hash picks the shard and is then used by it.
+void ShardedBloomFilter::insert(string_view element){
+    uint64_t elem = hashKey(element.data(), element.size(), seed);
+    shards[shardOf(elem)]->insertHashed(element, elem);
+}
+
+bool ShardedBloomFilter::find(string_view element){
+    uint64_t elem = hashKey(element.data(), element.size(), seed);
+    return shards[shardOf(elem)]->findHashed(element, elem);
+}
+
+void ShardedBloomFilter::remove(string_view element){
+    uint64_t elem = hashKey(element.data(), element.size(), seed);
+    shards[shardOf(elem)]->remove(element);
+}
+
+//Hashes every key, sorts the keys by shard with a counting sort, then checks each shard's keys.
+void ShardedBloomFilter::findMany(const string_view* keys, size_t n, uint64_t* found){
+    vector<uint64_t> hashes(n);
+    vector<size_t> start(numShards + 1);
+    vector<size_t> order(n);
+    for(size_t i = 0; i < n; i++){
+        hashes[i] = hashKey(keys[i].data(), keys[i].size(), seed);
+        start[shardOf(hashes[i]) + 1]++;
+    }
+    for(int s = 0; s < numShards; s++){
+        start[s + 1] += start[s];
+    }
+    vector<size_t> next(start.begin(), start.end() - 1);
+    for(size_t i = 0; i < n; i++){
+        order[next[shardOf(hashes[i])]++] = i;
+    }
+    memset(found, 0, ((n + 63) / 64) * 8);
+    for(int s = 0; s < numShards; s++){
+        for(size_t j = start[s]; j < start[s + 1]; j++){
+            size_t i = order[j];
+            if(shards[s]->findHashed(keys[i], hashes[i])){
+                found[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+}
+
+void ShardedBloomFilter::partition(const string_view* keys, size_t n, vector<vector<size_t>>& byNode){
+    byNode.assign(topology.nodes(), vector<size_t>());
+    for(size_t i = 0; i < n; i++){
+        byNode[nodeOf(keys[i])].push_back(i);
+    }
+}
+
+//Adds up the statistics of the shards. Keys are spread evenly, so the false positive rate is
+//the average of the shards' rates.
+BloomStats ShardedBloomFilter::stats(){
+    BloomStats total;
+    memset(&total, 0, sizeof(total));
+    for(BloomFilter* b : shards){
+        BloomStats st = b->stats();
+        total.inserts += st.inserts;
+        total.lookups += st.lookups;
+        total.positives += st.positives;
+        total.negatives += st.negatives;
+        total.tombstoneHits += st.tombstoneHits;
+        total.removes += st.removes;
+        total.tombstones += st.tombstones;
+        total.size += st.size;
+        total.numHash = st.numHash;
+        total.bitsSet += st.bitsSet;
+        total.estimatedCount += st.estimatedCount;
+        total.estimatedFpr += st.estimatedFpr / numShards;
+    }
+    total.fillRatio = total.size > 0 ? double(total.bitsSet) / total.size : 0;
+    return total;
+}
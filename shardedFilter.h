@@ -0,0 +1,61 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include <vector>
+#include "bloomFilter.h"
+
+//NUMA topology of the machine, read from /sys/devices/system/node.
+//A machine without that directory counts as one node with every cpu on it.
+struct NumaTopology {
+    vector<vector<int>> nodeCpus; //cpus of each node
+    static NumaTopology read(); //reads the topology of this machine
+    int nodes(); //number of nodes
+    int nodeOfCpu(int cpu); //node a cpu is on, 0 if it isn't found
+    int currentNode(); //node of the cpu the calling thread is running on
+    bool pinToNode(int node); //lets the calling thread only run on the cpus of node
+};
+
+//Bloom filter split into independent shards, each a BloomFilter of its own.
+//A key's shard is picked from its hash, so every key lives in exactly one shard and shards
+//never need to agree on anything. Shard i is placed on NUMA node i % nodes: it is made by a
+//thread running on that node, so the first touch of its memory (and its remove hash table)
+//puts the pages there. Built with -DBLOOM_NUMA (and -lnuma) the bit arrays are also bound to
+//the node with libnuma, so they stay there even if another node touches them first.
+//Keys are spread evenly, so a thread looking up random keys still goes to other nodes for
+//most of them. partition splits a batch by the node owning each key, so each part can be
+//handed to a thread pinned to that node (see NumaTopology::pinToNode) and all of its
+//lookups stay local.
+class ShardedBloomFilter {
+  public:
+    //constructor.
+    //p = probability of false positive of every shard
+    //m = expected number of elements in the whole filter, split evenly across the shards
+    //shards = number of shards, 0 for one per NUMA node
+    //layout = bit layout of the shards
+    //concurrent = true if many threads will insert and find at the same time
+    //seed = seed of the key hash, shared by every shard
+    ShardedBloomFilter(double p, int m, int shards = 0, BloomLayout layout = BLOOM_BLOCKED, bool concurrent = true,
+                       uint64_t seed = DEFAULT_SEED);
+    ~ShardedBloomFilter(); //destructor
+    void insert(string_view element); //inserts into the element's shard
+    void remove(string_view element); //removes from the element's shard
+    bool find(string_view element); //checks the element's shard
+    //Checks n keys at once, the same as BloomFilter::findMany. Keys are hashed once and each
+    //shard's keys are checked together, so one shard's bits are in the cache at a time.
+    void findMany(const string_view* keys, size_t n, uint64_t* found);
+    int shardOf(uint64_t elem); //shard of a key hash
+    int nodeOf(string_view element); //NUMA node holding the element's shard
+    //Splits keys by the node holding their shard: byNode[node] gets the index of every key
+    //which belongs to node.
+    void partition(const string_view* keys, size_t n, vector<vector<size_t>>& byNode);
+    BloomStats stats(); //statistics of every shard added together
+
+    //Data
+    int numShards; //number of shards
+    uint64_t seed; //seed of the key hash
+    NumaTopology topology; //NUMA nodes the shards are spread over
+    vector<BloomFilter*> shards; //the shards
+    vector<int> shardNode; //NUMA node of each shard
+};
+
+#endif